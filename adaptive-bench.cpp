@@ -0,0 +1,60 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "bst.h"
+#include "avlbst.h"
+#include "adaptivebst.h"
+
+using namespace std;
+
+// Many small maps: building them from random keys and looking keys up,
+// as AVLTrees and as AdaptiveAVLTrees, for a few map sizes around the
+// promotion threshold.
+//   usage: ./adaptive-bench [totalItems] [numLookups]
+
+static double nanosSince(chrono::steady_clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ops;
+}
+
+template<typename Map>
+void run(const char* name, size_t mapSize, size_t numMaps, size_t numLookups)
+{
+    mt19937_64 rng(108);
+    vector<uint64_t> keys(mapSize * numMaps);
+    for (size_t i = 0; i < keys.size(); i++) keys[i] = rng();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<Map> maps(numMaps);
+    for (size_t m = 0; m < numMaps; m++)
+    {
+        for (size_t i = 0; i < mapSize; i++) maps[m].insert(make_pair(keys[m * mapSize + i], (uint64_t)i));
+    }
+    double buildNs = nanosSince(start, keys.size());
+
+    vector<size_t> probes(numLookups);
+    for (size_t i = 0; i < numLookups; i++) probes[i] = rng() % keys.size();
+    uint64_t sum = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numLookups; i++) sum += *maps[probes[i] / mapSize].get(keys[probes[i]]);
+    double lookupNs = nanosSince(start, numLookups);
+
+    cout << "size " << mapSize << (mapSize < 10 ? "  " : " ") << name << ": insert " << buildNs
+         << " ns/item, lookup " << lookupNs << " ns/op" << (sum == 0 ? " (no hits)" : "") << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t totalItems = argc > 1 ? atol(argv[1]) : 2000000;
+    size_t numLookups = argc > 2 ? atol(argv[2]) : 4000000;
+
+    size_t sizes[] = { 4, 16, 32, 64 };
+    for (size_t s = 0; s < 4; s++)
+    {
+        run<AVLTree<uint64_t, uint64_t> >("AVLTree        ", sizes[s], totalItems / sizes[s], numLookups);
+        run<AdaptiveAVLTree<uint64_t, uint64_t> >("AdaptiveAVLTree", sizes[s], totalItems / sizes[s], numLookups);
+    }
+    return 0;
+}
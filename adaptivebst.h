@@ -0,0 +1,313 @@
+#ifndef ADAPTIVEBST_H
+#define ADAPTIVEBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include "avlbst.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+// move to an AVLTree when an insert would grow the array past this size
+#define ADAPTIVE_PROMOTE_SIZE 32
+// move back to an array when a remove shrinks the tree below this size;
+// the gap keeps a map near the threshold from flipping back and forth
+#define ADAPTIVE_DEMOTE_SIZE 16
+
+/*
+ * Position of the first key not less than key in the sorted array keys.
+ * The general version is a binary search; integral keys are counted
+ * instead (keys less than key), which has no unpredictable branches and,
+ * for 32-bit keys (and 64-bit keys with SSE4.2), compares several keys
+ * per instruction. For arrays of a few dozen keys that beats a binary
+ * search.
+ */
+template <typename Key, bool integral = std::is_integral<Key>::value>
+struct SortedArraySearch
+{
+    static size_t lowerBound(const Key* keys, size_t count, const Key& key)
+    {
+        return std::lower_bound(keys, keys + count, key) - keys;
+    }
+};
+
+template <typename Key>
+struct SortedArraySearch<Key, true>
+{
+    static size_t lowerBound(const Key* keys, size_t count, const Key& key)
+    {
+        size_t i = 0;
+        size_t less = 0;
+#ifdef __SSE2__
+        if (sizeof(Key) == 4)
+        {
+            // SSE2 only compares signed lanes: flipping the sign bit of
+            // unsigned keys keeps their order
+            const int32_t flip = std::is_signed<Key>::value ? 0 : INT32_MIN;
+            __m128i needle = _mm_set1_epi32((int32_t)key ^ flip);
+            __m128i flips = _mm_set1_epi32(flip);
+            __m128i counts = _mm_setzero_si128();
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i lanes = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), flips);
+                counts = _mm_sub_epi32(counts, _mm_cmplt_epi32(lanes, needle)); // true lanes are -1
+            }
+            int32_t lanes[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), counts);
+            less = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+#endif
+#ifdef __SSE4_2__
+        if (sizeof(Key) == 8)
+        {
+            const int64_t flip = std::is_signed<Key>::value ? 0 : INT64_MIN;
+            __m128i needle = _mm_set1_epi64x((int64_t)key ^ flip);
+            __m128i flips = _mm_set1_epi64x(flip);
+            __m128i counts = _mm_setzero_si128();
+            for (; i + 2 <= count; i += 2)
+            {
+                __m128i lanes = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), flips);
+                counts = _mm_sub_epi64(counts, _mm_cmpgt_epi64(needle, lanes));
+            }
+            int64_t lanes[2];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), counts);
+            less = (size_t)(lanes[0] + lanes[1]);
+        }
+#endif
+        for (; i < count; i++) less += keys[i] < key;
+        return less;
+    }
+};
+
+/**
+* A map that keeps up to ADAPTIVE_PROMOTE_SIZE items in a sorted array
+* (keys and values in separate arrays, so a search only reads keys) and
+* switches to an AVLTree, built in linear time with bulkBuild, once it
+* grows past that. It switches back when it shrinks below
+* ADAPTIVE_DEMOTE_SIZE. Small maps thus cost two allocations instead of
+* one per item and are searched without chasing pointers.
+*
+* Pointers returned by get() are invalidated by insert and remove.
+*/
+template <class Key, class Value>
+class AdaptiveAVLTree
+{
+public:
+    AdaptiveAVLTree();
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    void remove(const Key& key);
+    void clear();
+
+    bool contains(const Key& key) const;
+    Value* get(const Key& key);
+    const Value* get(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+    template<typename Function>
+    void forEach(Function fn) const;
+
+    size_t size() const;
+    bool empty() const;
+    bool isPromoted() const;
+
+protected:
+    size_t position(const Key& key) const;
+    void promote(size_t pos, const std::pair<const Key, Value>& new_item);
+    void demote();
+
+protected:
+    std::vector<Key> keys_;
+    std::vector<Value> values_;
+    AVLTree<Key, Value> tree_;
+    bool promoted_;
+};
+
+template<class Key, class Value>
+AdaptiveAVLTree<Key, Value>::AdaptiveAVLTree() :
+    promoted_(false)
+{
+
+}
+
+template<class Key, class Value>
+void AdaptiveAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    if (promoted_)
+    {
+        tree_.insert(new_item);
+        return;
+    }
+
+    size_t pos = position(new_item.first);
+    if (pos < keys_.size() && keys_[pos] == new_item.first)
+    {
+        values_[pos] = new_item.second;
+        return;
+    }
+    if (keys_.size() == ADAPTIVE_PROMOTE_SIZE)
+    {
+        promote(pos, new_item);
+        return;
+    }
+    keys_.insert(keys_.begin() + pos, new_item.first);
+    values_.insert(values_.begin() + pos, new_item.second);
+}
+
+template<class Key, class Value>
+void AdaptiveAVLTree<Key, Value>::remove(const Key& key)
+{
+    if (promoted_)
+    {
+        tree_.remove(key);
+        if (tree_.size() < ADAPTIVE_DEMOTE_SIZE) demote();
+        return;
+    }
+
+    size_t pos = position(key);
+    if (pos == keys_.size() || !(keys_[pos] == key)) return;
+    keys_.erase(keys_.begin() + pos);
+    values_.erase(values_.begin() + pos);
+}
+
+template<class Key, class Value>
+void AdaptiveAVLTree<Key, Value>::clear()
+{
+    keys_.clear();
+    values_.clear();
+    tree_.clear();
+    promoted_ = false;
+}
+
+template<class Key, class Value>
+bool AdaptiveAVLTree<Key, Value>::contains(const Key& key) const
+{
+    return get(key) != nullptr;
+}
+
+/**
+* Returns a pointer to the value for key, or NULL if it is not present.
+*/
+template<class Key, class Value>
+Value* AdaptiveAVLTree<Key, Value>::get(const Key& key)
+{
+    if (promoted_) return tree_.get(key);
+    size_t pos = position(key);
+    if (pos == keys_.size() || !(keys_[pos] == key)) return nullptr;
+    return &values_[pos];
+}
+
+template<class Key, class Value>
+const Value* AdaptiveAVLTree<Key, Value>::get(const Key& key) const
+{
+    return const_cast<AdaptiveAVLTree<Key, Value>*>(this)->get(key);
+}
+
+template<class Key, class Value>
+Value& AdaptiveAVLTree<Key, Value>::operator[](const Key& key)
+{
+    Value* value = get(key);
+    if (value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+template<class Key, class Value>
+Value const & AdaptiveAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    const Value* value = get(key);
+    if (value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+/**
+* Calls fn(key, value) for every item in key order.
+*/
+template<class Key, class Value>
+template<typename Function>
+void AdaptiveAVLTree<Key, Value>::forEach(Function fn) const
+{
+    if (promoted_)
+    {
+        for (typename AVLTree<Key, Value>::iterator it = tree_.begin(); it != tree_.end(); ++it) fn(it->first, it->second);
+        return;
+    }
+    for (size_t i = 0; i < keys_.size(); i++) fn(keys_[i], values_[i]);
+}
+
+template<class Key, class Value>
+size_t AdaptiveAVLTree<Key, Value>::size() const
+{
+    return promoted_ ? tree_.size() : keys_.size();
+}
+
+template<class Key, class Value>
+bool AdaptiveAVLTree<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* True while the items are held in the AVLTree rather than the array.
+*/
+template<class Key, class Value>
+bool AdaptiveAVLTree<Key, Value>::isPromoted() const
+{
+    return promoted_;
+}
+
+template<class Key, class Value>
+size_t AdaptiveAVLTree<Key, Value>::position(const Key& key) const
+{
+    return SortedArraySearch<Key>::lowerBound(keys_.data(), keys_.size(), key);
+}
+
+/*
+ * Moves the array, with new_item added at pos, into the tree. The items
+ * are already sorted, so bulkBuild builds the tree in linear time.
+ */
+template<class Key, class Value>
+void AdaptiveAVLTree<Key, Value>::promote(size_t pos, const std::pair<const Key, Value>& new_item)
+{
+    std::vector<std::pair<Key, Value> > items;
+    items.reserve(keys_.size() + 1);
+    for (size_t i = 0; i < keys_.size(); i++)
+    {
+        if (i == pos) items.push_back(std::make_pair(new_item.first, new_item.second));
+        items.push_back(std::make_pair(keys_[i], values_[i]));
+    }
+    if (pos == keys_.size()) items.push_back(std::make_pair(new_item.first, new_item.second));
+
+    tree_.bulkBuild(std::move(items), 1);
+    std::vector<Key>().swap(keys_);
+    std::vector<Value>().swap(values_);
+    promoted_ = true;
+}
+
+/*
+ * Moves the tree's items back into the array, in order.
+ */
+template<class Key, class Value>
+void AdaptiveAVLTree<Key, Value>::demote()
+{
+    keys_.reserve(ADAPTIVE_PROMOTE_SIZE);
+    values_.reserve(ADAPTIVE_PROMOTE_SIZE);
+    for (typename AVLTree<Key, Value>::iterator it = tree_.begin(); it != tree_.end(); ++it)
+    {
+        keys_.push_back(it->first);
+        values_.push_back(it->second);
+    }
+    tree_.clear();
+    promoted_ = false;
+}
+
+#endif
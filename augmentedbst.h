@@ -0,0 +1,248 @@
+#ifndef AUGMENTEDBST_H
+#define AUGMENTEDBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <limits>
+#include "avlbst.h"
+
+/*
+ * Augmentation policies. A policy describes a monoid over values:
+ *
+ *   typedef ... value_type;                  // type of the aggregate
+ *   static value_type identity();            // aggregate of an empty range
+ *   static value_type lift(const Value& v);  // aggregate of a single item
+ *   static value_type combine(const value_type& lhs, const value_type& rhs);
+ *
+ * combine must be associative; it does not need to be commutative, the
+ * tree always combines in key order.
+ */
+
+template <typename Value>
+struct SumAugment
+{
+    typedef Value value_type;
+    static Value identity() { return Value(); }
+    static Value lift(const Value& v) { return v; }
+    static Value combine(const Value& lhs, const Value& rhs) { return lhs + rhs; }
+};
+
+template <typename Value>
+struct MinAugment
+{
+    typedef Value value_type;
+    static Value identity() { return std::numeric_limits<Value>::max(); }
+    static Value lift(const Value& v) { return v; }
+    static Value combine(const Value& lhs, const Value& rhs) { return rhs < lhs ? rhs : lhs; }
+};
+
+template <typename Value>
+struct MaxAugment
+{
+    typedef Value value_type;
+    static Value identity() { return std::numeric_limits<Value>::lowest(); }
+    static Value lift(const Value& v) { return v; }
+    static Value combine(const Value& lhs, const Value& rhs) { return lhs < rhs ? rhs : lhs; }
+};
+
+/**
+* An AVLNode that also stores the aggregate of its whole subtree.
+*/
+template <typename Key, typename Value, typename Policy>
+class AugmentedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    typedef typename Policy::value_type Aggregate;
+
+    AugmentedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~AugmentedAVLNode();
+
+    const Aggregate& getAggregate() const;
+    void setAggregate(const Aggregate& aggregate);
+
+    virtual AugmentedAVLNode<Key, Value, Policy>* clone(Node<Key, Value>* parent) const override;
+
+protected:
+    Aggregate aggregate_;
+};
+
+template<class Key, class Value, class Policy>
+AugmentedAVLNode<Key, Value, Policy>::AugmentedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), aggregate_(Policy::lift(value))
+{
+
+}
+
+template<class Key, class Value, class Policy>
+AugmentedAVLNode<Key, Value, Policy>::~AugmentedAVLNode()
+{
+
+}
+
+template<class Key, class Value, class Policy>
+const typename AugmentedAVLNode<Key, Value, Policy>::Aggregate&
+AugmentedAVLNode<Key, Value, Policy>::getAggregate() const
+{
+    return aggregate_;
+}
+
+template<class Key, class Value, class Policy>
+void AugmentedAVLNode<Key, Value, Policy>::setAggregate(const Aggregate& aggregate)
+{
+    aggregate_ = aggregate;
+}
+
+template<class Key, class Value, class Policy>
+AugmentedAVLNode<Key, Value, Policy>* AugmentedAVLNode<Key, Value, Policy>::clone(Node<Key, Value>* parent) const
+{
+    AugmentedAVLNode<Key, Value, Policy>* copy = new AugmentedAVLNode<Key, Value, Policy>(
+        this->getKey(), this->getValue(), static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setBalance(this->balance_);
+    copy->aggregate_ = aggregate_;
+    return copy;
+}
+
+/**
+* An AVLTree whose nodes carry the Policy aggregate of their subtree. The
+* aggregates are kept up to date through insert, remove, rotations and node
+* swaps, so the aggregate over any key range takes O(log n).
+*
+* Values must only be changed through insert(); writing through operator[]
+* or an iterator bypasses the aggregate maintenance.
+*/
+template <class Key, class Value, class Policy>
+class AugmentedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename Policy::value_type Aggregate;
+
+    Aggregate aggregate() const;
+    Aggregate aggregate(const Key& lo, const Key& hi) const;
+
+protected:
+    typedef AugmentedAVLNode<Key, Value, Policy> AugNode;
+
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual void updateNode(AVLNode<Key, Value>* thisNode);
+    virtual void updatePath(AVLNode<Key, Value>* thisNode);
+    virtual size_t nodeBytes() const;
+    virtual const std::type_info& nodeType() const;
+
+    static Aggregate subtreeAggregate(Node<Key, Value>* thisNode);
+};
+
+/**
+* Returns the aggregate over all items in the tree.
+*/
+template<class Key, class Value, class Policy>
+typename AugmentedAVLTree<Key, Value, Policy>::Aggregate
+AugmentedAVLTree<Key, Value, Policy>::aggregate() const
+{
+    return subtreeAggregate(this->root_);
+}
+
+/**
+* Returns the aggregate over all items with lo <= key <= hi, combined in
+* key order, or Policy::identity() if there are none.
+*/
+template<class Key, class Value, class Policy>
+typename AugmentedAVLTree<Key, Value, Policy>::Aggregate
+AugmentedAVLTree<Key, Value, Policy>::aggregate(const Key& lo, const Key& hi) const
+{
+    // walk down to the first node inside the range; everything in the range
+    // is in its subtree
+    Node<Key, Value>* splitNode = this->root_;
+    while (splitNode != nullptr)
+    {
+        if (splitNode->getKey() < lo) splitNode = splitNode->getRight();
+        else if (hi < splitNode->getKey()) splitNode = splitNode->getLeft();
+        else break;
+    }
+    if (splitNode == nullptr) return Policy::identity();
+
+    // left boundary: each node >= lo contributes itself and its right subtree,
+    // and comes before everything collected so far
+    Aggregate leftPart = Policy::identity();
+    Node<Key, Value>* currentNode = splitNode->getLeft();
+    while (currentNode != nullptr)
+    {
+        if (currentNode->getKey() < lo)
+        {
+            currentNode = currentNode->getRight();
+        }
+        else
+        {
+            leftPart = Policy::combine(Policy::combine(Policy::lift(currentNode->getValue()),
+                                                       subtreeAggregate(currentNode->getRight())),
+                                       leftPart);
+            currentNode = currentNode->getLeft();
+        }
+    }
+
+    // right boundary, mirrored
+    Aggregate rightPart = Policy::identity();
+    currentNode = splitNode->getRight();
+    while (currentNode != nullptr)
+    {
+        if (hi < currentNode->getKey())
+        {
+            currentNode = currentNode->getLeft();
+        }
+        else
+        {
+            rightPart = Policy::combine(rightPart,
+                                        Policy::combine(subtreeAggregate(currentNode->getLeft()),
+                                                        Policy::lift(currentNode->getValue())));
+            currentNode = currentNode->getRight();
+        }
+    }
+
+    return Policy::combine(Policy::combine(leftPart, Policy::lift(splitNode->getValue())), rightPart);
+}
+
+template<class Key, class Value, class Policy>
+AVLNode<Key, Value>* AugmentedAVLTree<Key, Value, Policy>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new AugNode(key, value, parent);
+}
+
+template<class Key, class Value, class Policy>
+size_t AugmentedAVLTree<Key, Value, Policy>::nodeBytes() const
+{
+    return sizeof(AugNode);
+}
+
+template<class Key, class Value, class Policy>
+const std::type_info& AugmentedAVLTree<Key, Value, Policy>::nodeType() const
+{
+    return typeid(AugNode);
+}
+
+template<class Key, class Value, class Policy>
+void AugmentedAVLTree<Key, Value, Policy>::updateNode(AVLNode<Key, Value>* thisNode)
+{
+    static_cast<AugNode*>(thisNode)->setAggregate(
+        Policy::combine(Policy::combine(subtreeAggregate(thisNode->getLeft()), Policy::lift(thisNode->getValue())),
+                        subtreeAggregate(thisNode->getRight())));
+}
+
+template<class Key, class Value, class Policy>
+void AugmentedAVLTree<Key, Value, Policy>::updatePath(AVLNode<Key, Value>* thisNode)
+{
+    while (thisNode != nullptr)
+    {
+        updateNode(thisNode);
+        thisNode = thisNode->getParent();
+    }
+}
+
+template<class Key, class Value, class Policy>
+typename AugmentedAVLTree<Key, Value, Policy>::Aggregate
+AugmentedAVLTree<Key, Value, Policy>::subtreeAggregate(Node<Key, Value>* thisNode)
+{
+    if (thisNode == nullptr) return Policy::identity();
+    return static_cast<AugNode*>(thisNode)->getAggregate();
+}
+
+#endif
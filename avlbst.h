@@ -6,10 +6,18 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <vector>
+#include <thread>
 #include "bst.h"
 
 struct KeyError { };
 
+// ranges smaller than this are sorted/built on the calling thread
+#define AVL_PARALLEL_CUTOFF 16384
+// eraseIf relinks the survivors into a new tree once at least this
+// percentage of the items goes; below it, matches are removed one by one
+#define AVL_ERASE_REBUILD_PERCENT 20
+
 /**
 * A special kind of node for an AVL tree, which adds the balance as a data member, plus
 * other additional helper functions. You do NOT need to implement any functionality or
@@ -35,6 +43,8 @@ public:
     virtual AVLNode<Key, Value>* getLeft() const override;
     virtual AVLNode<Key, Value>* getRight() const override;
 
+    virtual AVLNode<Key, Value>* clone(Node<Key, Value>* parent) const override;
+
 protected:
     int8_t balance_;    // effectively a signed char
 };
@@ -120,6 +130,19 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 }
 
 
+/**
+* Copies the item and the balance factor.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLNode<Key, Value>::clone(Node<Key, Value>* parent) const
+{
+    AVLNode<Key, Value>* copy = new AVLNode<Key, Value>(this->getKey(), this->getValue(),
+                                                        static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setBalance(balance_);
+    return copy;
+}
+
+
 /*
   -----------------------------------------------
   End implementations for the AVLNode class.
@@ -131,20 +154,155 @@ template <class Key, class Value>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
+    AVLTree();
+    AVLTree(const AVLTree<Key, Value>& other);
+    AVLTree(AVLTree<Key, Value>&& other);
+    AVLTree<Key, Value>& operator=(const AVLTree<Key, Value>& other);
+    AVLTree<Key, Value>& operator=(AVLTree<Key, Value>&& other);
     virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    typename BinarySearchTree<Key, Value>::iterator insert(
+        typename BinarySearchTree<Key, Value>::iterator hint, const std::pair<const Key, Value> &new_item);
     virtual void remove(const Key& key);  // TODO
+    using BinarySearchTree<Key, Value>::insert;
+    void bulkBuild(std::vector<std::pair<Key, Value> > items, unsigned threads = 0);
+    using BinarySearchTree<Key, Value>::erase;
+    typename BinarySearchTree<Key, Value>::iterator erase(
+        typename BinarySearchTree<Key, Value>::iterator first, typename BinarySearchTree<Key, Value>::iterator last);
+    void eraseRange(const Key& lo, const Key& hi);
+    template<typename Predicate>
+    size_t eraseIf(Predicate pred);
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual void unlinkNode(Node<Key, Value>* node);
+    virtual bool insertNode(Node<Key, Value>* node);
+    virtual bool checkNodeBalance(const Node<Key, Value>* thisNode, int leftHeight, int rightHeight) const;
+    virtual bool keepsBalance() const;
+    virtual size_t nodeBytes() const;
+    virtual const std::type_info& nodeType() const;
+    virtual void afterStructureChange();
 
     // Add helper functions here
+    AVLNode<Key,Value>* internalInsert(const std::pair<const Key, Value> &new_item);
+    AVLNode<Key,Value>* insertionParent(const Key& key) const;
+    void attachNode(AVLNode<Key,Value>* parent, AVLNode<Key,Value>* newNode);
+    void linkNode(AVLNode<Key,Value>* parent, AVLNode<Key,Value>* newNode, bool asLeft);
+    void findRightmost();
+
+    // Extension points for trees that keep extra per-node data (see augmentedbst.h)
+    virtual AVLNode<Key,Value>* createNode(const Key& key, const Value& value, AVLNode<Key,Value>* parent);
+    virtual void updateNode(AVLNode<Key,Value>* thisNode);
+    virtual void updatePath(AVLNode<Key,Value>* thisNode);
+    // Called for every node linked in one at a time, and for every detached
+    // subtree freed by a range erase, for trees that track their keys
+    virtual void nodeLinked(AVLNode<Key,Value>* node);
+    virtual void subtreeErased(AVLNode<Key,Value>* subtree);
     void insertFix(AVLNode<Key,Value>* parent, AVLNode<Key,Value>* thisNode);
     void removeFix(AVLNode<Key, Value>* parent, int8_t diff);
     void rotateRight(AVLNode<Key,Value>* thisNode);
     void rotateLeft(AVLNode<Key,Value>* thisNode);
 
+    static bool keyLess(const std::pair<Key, Value>& lhs, const std::pair<Key, Value>& rhs);
+    static void sortRange(std::vector<std::pair<Key, Value> >* items, size_t lo, size_t hi,
+                          std::exception_ptr* error);
+    static void mergeRanges(std::vector<std::pair<Key, Value> >* items, size_t lo, size_t mid, size_t hi,
+                            std::exception_ptr* error);
+    static void parallelSort(std::vector<std::pair<Key, Value> >& items, unsigned threads);
+    void buildRange(const std::vector<std::pair<Key, Value> >* items, size_t lo, size_t hi,
+                    AVLNode<Key, Value>* parent, unsigned threads, AVLNode<Key, Value>** result, int* height);
+    void buildWorker(const std::vector<std::pair<Key, Value> >* items, size_t lo, size_t hi,
+                     AVLNode<Key, Value>* parent, unsigned threads, AVLNode<Key, Value>** result, int* height,
+                     std::exception_ptr* error);
+    void relinkRange(AVLNode<Key, Value>* const* nodes, size_t lo, size_t hi, AVLNode<Key, Value>* parent,
+                     AVLNode<Key, Value>** result, int* height);
 
+    void eraseKeys(const Key& lo, const Key* hi, bool includeHi);
+    static int subtreeHeight(const AVLNode<Key, Value>* thisNode);
+    void splitTree(AVLNode<Key, Value>* thisNode, int height, const Key& key, bool equalLeft,
+                   AVLNode<Key, Value>** left, int* leftHeight, AVLNode<Key, Value>** right, int* rightHeight);
+    AVLNode<Key, Value>* splitFirst(AVLNode<Key, Value>* thisNode, int height, AVLNode<Key, Value>** rest, int* restHeight);
+    AVLNode<Key, Value>* joinTrees(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* pivot,
+                                   AVLNode<Key, Value>* right, int rightHeight, int* height);
+
+protected:
+    // Finger on the node with the largest key, so appends skip the descent.
+    // Only meaningful while root_ is not NULL.
+    AVLNode<Key, Value>* rightmost_;
 };
 
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree() :
+    BinarySearchTree<Key, Value>(), rightmost_(nullptr)
+{
+
+}
+
+/*
+ * The copy has the same shape and balance factors, so nothing is rebalanced.
+ */
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(const AVLTree<Key, Value>& other) :
+    BinarySearchTree<Key, Value>(other), rightmost_(nullptr)
+{
+    findRightmost();
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(AVLTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other)), rightmost_(other.rightmost_)
+{
+    other.rightmost_ = nullptr;
+}
+
+/*
+ * rightmost_ follows the new nodes through afterStructureChange(), as it
+ * does for assignment and swap through a BinarySearchTree reference.
+ */
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(const AVLTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(AVLTree<Key, Value>&& other)
+{
+    BinarySearchTree<Key, Value>::operator=(std::move(other));
+    return *this;
+}
+
+/*
+ * Points rightmost_ at the node with the largest key, in O(log n).
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::findRightmost()
+{
+    rightmost_ = static_cast<AVLNode<Key, Value>*>(this->root_);
+    if (rightmost_ == nullptr) return;
+    while (rightmost_->getRight() != nullptr) rightmost_ = rightmost_->getRight();
+}
+
+/*
+ * rightmost_ is derived from the nodes, so it is looked up again.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::afterStructureChange()
+{
+    findRightmost();
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::nodeLinked(AVLNode<Key, Value>* node)
+{
+
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::subtreeErased(AVLNode<Key, Value>* subtree)
+{
+
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
@@ -152,23 +310,127 @@ protected:
 template<class Key, class Value>
 void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
 {
-    if (this->root_ == nullptr) // If the tree is empty
+    BST_LATENCY_SCOPE(LATENCY_INSERT, this->size_);
+    internalInsert(new_item);
+}
+
+/*
+ * Inserts new_item, using hint as a starting point. If the key belongs
+ * right before or right after the hint, the node is linked next to it
+ * without descending from the root, so feeding back the returned iterator
+ * makes (nearly) sorted input cost amortized O(1) per insert.
+ * A wrong hint only costs the normal O(log n) insert.
+ * Returns an iterator to the item with the new key.
+ */
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+AVLTree<Key, Value>::insert(typename BinarySearchTree<Key, Value>::iterator hint,
+                            const std::pair<const Key, Value> &new_item)
+{
+    BST_LATENCY_SCOPE(LATENCY_INSERT, this->size_);
+    AVLNode<Key, Value>* hintNode = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(hint));
+    if (hintNode == nullptr || this->root_ == nullptr)
     {
-        this->root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr);
-        return;
+        return this->makeIterator(internalInsert(new_item));
     }
-    
+
+    if (hintNode->getKey() == new_item.first)
+    {
+        hintNode->setValue(new_item.second);
+        updatePath(hintNode);
+        return hint;
+    }
+
+    if (new_item.first < hintNode->getKey())
+    {
+        AVLNode<Key, Value>* prev = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(hintNode));
+        if (prev == nullptr || prev->getKey() < new_item.first)
+        {
+            // the key goes between prev and hintNode; one of the two has a free slot
+            AVLNode<Key, Value>* parent = (hintNode->getLeft() == nullptr) ? hintNode : prev;
+            AVLNode<Key, Value>* newNode = createNode(new_item.first, new_item.second, parent);
+            linkNode(parent, newNode, parent == hintNode);
+            return this->makeIterator(newNode);
+        }
+    }
+    else
+    {
+        // the rightmost node's successor search would climb all the way to the root
+        AVLNode<Key, Value>* next = nullptr;
+        if (hintNode != rightmost_) next = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::successor(hintNode));
+        if (next == nullptr || new_item.first < next->getKey())
+        {
+            AVLNode<Key, Value>* parent = (hintNode->getRight() == nullptr) ? hintNode : next;
+            AVLNode<Key, Value>* newNode = createNode(new_item.first, new_item.second, parent);
+            linkNode(parent, newNode, parent != hintNode);
+            return this->makeIterator(newNode);
+        }
+    }
+
+    // hint was not adjacent to the key
+    return this->makeIterator(internalInsert(new_item));
+}
+
+/*
+ * Inserts (or overwrites) new_item and returns the node holding its key.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::internalInsert(const std::pair<const Key, Value> &new_item)
+{
+    AVLNode<Key, Value>* parent = insertionParent(new_item.first);
+    if (parent != nullptr && parent->getKey() == new_item.first)
+    {
+        parent->setValue(new_item.second);
+        updatePath(parent);
+        return parent;
+    }
+
+    // Creating the new node
+    AVLNode<Key, Value>* newNode = createNode(new_item.first, new_item.second, parent);
+    attachNode(parent, newNode);
+    return newNode;
+}
+
+/*
+ * Links a detached AVLNode (e.g. from a NodeHandle) into the tree.
+ */
+template<class Key, class Value>
+bool AVLTree<Key, Value>::insertNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value>* newNode = static_cast<AVLNode<Key, Value>*>(node);
+    AVLNode<Key, Value>* parent = insertionParent(newNode->getKey());
+    if (parent != nullptr && parent->getKey() == newNode->getKey()) return false;
+
+    newNode->setParent(parent);
+    newNode->setLeft(nullptr);
+    newNode->setRight(nullptr);
+    newNode->setBalance(0);
+    attachNode(parent, newNode);
+    return true;
+}
+
+/*
+ * Returns the node holding key if there is one, otherwise the node whose
+ * empty child slot the key belongs in (NULL if the tree is empty).
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::insertionParent(const Key& key) const
+{
+    if (this->root_ == nullptr) return nullptr;
+
+    // appending past the largest key: the rightmost node has a free right slot
+    if (rightmost_->getKey() < key) return rightmost_;
+
     AVLNode<Key, Value>* currentNode = static_cast<AVLNode<Key, Value>*>(this->root_);
     AVLNode<Key, Value>* nextNode;
     
     while (true)
     {
-        if (currentNode->getKey() == new_item.first)
+        if (currentNode->getKey() == key)
         {
-            currentNode->setValue(new_item.second);
-            return;
+            return currentNode;
         }
-        else if (new_item.first < currentNode->getKey())
+        else if (key < currentNode->getKey())
         {
             nextNode = currentNode->getLeft();
         }
@@ -181,35 +443,63 @@ void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
         else currentNode = nextNode;
     }
     // by this point, currentNode is the parent, nextNode is where to insert
-    
-    // Creating the new node
-    AVLNode<Key, Value>* newNode = new AVLNode<Key,Value>(new_item.first, new_item.second, currentNode);
-    
+    return currentNode;
+}
+
+/*
+ * Hangs newNode below parent (as returned by insertionParent), or makes
+ * it the root if parent is NULL.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::attachNode(AVLNode<Key,Value>* parent, AVLNode<Key,Value>* newNode)
+{
+    if (parent == nullptr) // If the tree is empty
+    {
+        this->root_ = newNode;
+        rightmost_ = newNode;
+        this->size_++;
+        nodeLinked(newNode);
+        updatePath(newNode);
+        return;
+    }
+    linkNode(parent, newNode, newNode->getKey() < parent->getKey());
+}
+
+/*
+ * Hangs newNode off the free child slot of parent and rebalances.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::linkNode(AVLNode<Key,Value>* parent, AVLNode<Key,Value>* newNode, bool asLeft)
+{
+    this->size_++;
+
     // updating the parent nodes left/right
-    if (new_item.first < currentNode->getKey())
+    if (asLeft)
     {
-        currentNode->setLeft(newNode);
+        parent->setLeft(newNode);
     }
     else
     {
-        currentNode->setRight(newNode);
+        parent->setRight(newNode);
+        if (parent == rightmost_) rightmost_ = newNode;
     }
-
+    nodeLinked(newNode);
+    updatePath(newNode);
 
     // if parent node's balance is +- 1
-    int parentBalance = newNode->getParent()->getBalance();
+    int parentBalance = parent->getBalance();
     
     //Update parent node's balance
-    if (newNode->getParent()->getLeft() == newNode) newNode->getParent()->updateBalance(-1);
-    else newNode->getParent()->updateBalance(1);
+    if (asLeft) parent->updateBalance(-1);
+    else parent->updateBalance(1);
     if (parentBalance == 1 || parentBalance == -1)
     {
-        newNode->getParent()->setBalance(0);
+        parent->setBalance(0);
         return;
     }
 
     // if parent node's balance is 0: gotta fricking rotate and fix
-    insertFix(newNode->getParent(), newNode);
+    insertFix(parent, newNode);
 }
 
 template<class Key, class Value>
@@ -391,14 +681,32 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* parent, AVLNode<Key,Valu
 template<class Key, class Value>
 void AVLTree<Key, Value>:: remove(const Key& key)
 {
+    BST_LATENCY_SCOPE(LATENCY_REMOVE, this->size_);
     AVLNode<Key, Value>* nodeToRemove = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
     if (nodeToRemove == nullptr) return;
+    unlinkNode(nodeToRemove);
+    delete nodeToRemove;
+}
+
+/*
+ * Detaches a node without freeing it and rebalances the tree.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::unlinkNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value>* nodeToRemove = static_cast<AVLNode<Key, Value>*>(node);
+    this->size_--;
     if (nodeToRemove == this->root_ && nodeToRemove->getLeft() == nullptr && nodeToRemove->getRight() == nullptr)
     {
-        delete nodeToRemove;
         this->root_ = nullptr;
+        rightmost_ = nullptr;
         return;
     }
+    // the rightmost node has no right child, so its predecessor takes over
+    if (nodeToRemove == rightmost_)
+    {
+        rightmost_ = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(nodeToRemove));
+    }
 
     if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() != nullptr)
     {
@@ -406,7 +714,7 @@ void AVLTree<Key, Value>:: remove(const Key& key)
     }
 
     AVLNode<Key, Value>* parent = nodeToRemove->getParent();
-    int8_t diff;
+    int8_t diff = 0;
     if (parent != nullptr)
     {
         if (parent->getLeft() == nodeToRemove) diff = 1;
@@ -464,11 +772,9 @@ void AVLTree<Key, Value>:: remove(const Key& key)
             parent->setRight(nullptr);
         }
     }
-    delete nodeToRemove;
-
     //patch tree
+    updatePath(parent);
     removeFix(parent, diff);
-    return;
 }
 
 template<class Key, class Value>
@@ -477,7 +783,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* parent, int8_t diff)
     if (parent == nullptr) return;
 
     AVLNode<Key, Value>* nextParent = parent->getParent();
-    int8_t ndiff;
+    int8_t ndiff = 0;
     if (nextParent != nullptr)
     {
         if (nextParent->getLeft() == parent) ndiff = 1;
@@ -606,6 +912,620 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* parent, int8_t diff)
     }
 }
 
+/*
+ * The stored balance must equal height(right) - height(left).
+ */
+template<class Key, class Value>
+bool AVLTree<Key, Value>::checkNodeBalance(const Node<Key, Value>* thisNode, int leftHeight, int rightHeight) const
+{
+    return static_cast<const AVLNode<Key, Value>*>(thisNode)->getBalance() == rightHeight - leftHeight;
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::keepsBalance() const
+{
+    return true;
+}
+
+/*
+ * Replaces the contents of the tree with items, which may be in any order.
+ * If a key appears more than once the last occurrence wins, as if the
+ * items had been inserted one by one. The items are sorted with a
+ * parallel merge sort and the perfectly balanced tree is built top-down,
+ * with large subtrees built on their own threads, in O(n log n / threads).
+ * threads = 0 uses every hardware thread. If the sort throws the tree is
+ * unchanged; if building a node throws the tree is left empty.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::bulkBuild(std::vector<std::pair<Key, Value> > items, unsigned threads)
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    if (!std::is_sorted(items.begin(), items.end(), keyLess)) parallelSort(items, threads);
+
+    // the sort is stable, so the last item of each run of equal keys is the newest
+    size_t kept = 0;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (i + 1 < items.size() && !keyLess(items[i], items[i + 1])) continue;
+        if (kept != i) items[kept] = items[i];
+        kept++;
+    }
+    items.resize(kept);
+
+    this->clear();
+    rightmost_ = nullptr;
+    if (items.empty()) return;
+
+    AVLNode<Key, Value>* root = nullptr;
+    int height = 0;
+    buildRange(&items, 0, items.size(), nullptr, threads, &root, &height);
+    this->root_ = root;
+    this->size_ = items.size();
+    afterStructureChange();
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::keyLess(const std::pair<Key, Value>& lhs, const std::pair<Key, Value>& rhs)
+{
+    return lhs.first < rhs.first;
+}
+
+/*
+ * The sort and merge steps of parallelSort, with any exception stored in
+ * *error instead of escaping the thread (which would terminate the program).
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::sortRange(std::vector<std::pair<Key, Value> >* items, size_t lo, size_t hi,
+                                    std::exception_ptr* error)
+{
+    try
+    {
+        std::stable_sort(items->begin() + lo, items->begin() + hi, keyLess);
+    }
+    catch (...)
+    {
+        *error = std::current_exception();
+    }
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::mergeRanges(std::vector<std::pair<Key, Value> >* items, size_t lo, size_t mid, size_t hi,
+                                      std::exception_ptr* error)
+{
+    try
+    {
+        std::inplace_merge(items->begin() + lo, items->begin() + mid, items->begin() + hi, keyLess);
+    }
+    catch (...)
+    {
+        *error = std::current_exception();
+    }
+}
+
+/*
+ * Stable merge sort: each thread sorts one slice, then neighbouring
+ * slices are merged pairwise, one round of merges in parallel at a time.
+ * Every worker is joined before the first exception (if any) is rethrown
+ * here; a slice whose thread cannot be started is sorted here instead.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::parallelSort(std::vector<std::pair<Key, Value> >& items, unsigned threads)
+{
+    size_t n = items.size();
+    if (threads > n / AVL_PARALLEL_CUTOFF) threads = (unsigned)(n / AVL_PARALLEL_CUTOFF);
+    if (threads <= 1)
+    {
+        std::stable_sort(items.begin(), items.end(), keyLess);
+        return;
+    }
+
+    std::vector<size_t> bounds(threads + 1);
+    for (unsigned i = 0; i <= threads; i++) bounds[i] = n * i / threads;
+
+    // reserved up front, so a started thread is never lost to a failed push_back
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(threads);
+    workers.reserve(threads);
+    for (unsigned i = 0; i < threads; i++)
+    {
+        try
+        {
+            workers.push_back(std::thread(&AVLTree<Key, Value>::sortRange, &items, bounds[i], bounds[i + 1],
+                                          &errors[i]));
+        }
+        catch (...)
+        {
+            sortRange(&items, bounds[i], bounds[i + 1], &errors[i]);
+        }
+    }
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+
+    for (unsigned width = 1; width < threads; width *= 2)
+    {
+        for (unsigned i = 0; i < threads; i++)
+        {
+            if (errors[i]) std::rethrow_exception(errors[i]);
+        }
+        workers.clear();
+        for (unsigned i = 0; i + width < threads; i += 2 * width)
+        {
+            unsigned hi = std::min(i + 2 * width, threads);
+            try
+            {
+                workers.push_back(std::thread(&AVLTree<Key, Value>::mergeRanges, &items, bounds[i],
+                                              bounds[i + width], bounds[hi], &errors[i]));
+            }
+            catch (...)
+            {
+                mergeRanges(&items, bounds[i], bounds[i + width], bounds[hi], &errors[i]);
+            }
+        }
+        for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+    }
+    for (unsigned i = 0; i < threads; i++)
+    {
+        if (errors[i]) std::rethrow_exception(errors[i]);
+    }
+}
+
+/*
+ * Builds a perfectly balanced subtree from the sorted, duplicate-free
+ * items[lo, hi) and reports its root and height. The middle item becomes
+ * the root, so the halves differ in size by at most one and every
+ * balance factor is 0 or +1. An exception on either side frees the
+ * partial subtree and is rethrown here, on the calling thread; if no
+ * thread can be started, the right side is built here as well.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::buildRange(const std::vector<std::pair<Key, Value> >* items, size_t lo, size_t hi,
+                                     AVLNode<Key, Value>* parent, unsigned threads,
+                                     AVLNode<Key, Value>** result, int* height)
+{
+    if (lo >= hi)
+    {
+        *result = nullptr;
+        *height = 0;
+        return;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    AVLNode<Key, Value>* thisNode = createNode((*items)[mid].first, (*items)[mid].second, parent);
+    AVLNode<Key, Value>* left = nullptr;
+    AVLNode<Key, Value>* right = nullptr;
+    int leftHeight = 0, rightHeight = 0;
+    std::exception_ptr leftError, rightError;
+
+    if (threads > 1 && hi - lo > AVL_PARALLEL_CUTOFF)
+    {
+        unsigned rightThreads = threads / 2;
+        std::thread worker;
+        try
+        {
+            worker = std::thread(&AVLTree<Key, Value>::buildWorker, this, items, mid + 1, hi, thisNode,
+                                 rightThreads, &right, &rightHeight, &rightError);
+        }
+        catch (...)
+        {
+            buildWorker(items, mid + 1, hi, thisNode, 1, &right, &rightHeight, &rightError);
+        }
+        buildWorker(items, lo, mid, thisNode, threads - rightThreads, &left, &leftHeight, &leftError);
+        if (worker.joinable()) worker.join();
+    }
+    else
+    {
+        buildWorker(items, lo, mid, thisNode, 1, &left, &leftHeight, &leftError);
+        if (!leftError) buildWorker(items, mid + 1, hi, thisNode, 1, &right, &rightHeight, &rightError);
+    }
+
+    thisNode->setLeft(left);
+    thisNode->setRight(right);
+    if (leftError || rightError)
+    {
+        this->clearHelp(thisNode);
+        std::rethrow_exception(leftError ? leftError : rightError);
+    }
+    thisNode->setBalance(rightHeight - leftHeight);
+    updateNode(thisNode);
+    *result = thisNode;
+    *height = 1 + std::max(leftHeight, rightHeight);
+}
+
+/*
+ * buildRange, with any exception stored in *error instead of escaping
+ * the thread.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::buildWorker(const std::vector<std::pair<Key, Value> >* items, size_t lo, size_t hi,
+                                      AVLNode<Key, Value>* parent, unsigned threads,
+                                      AVLNode<Key, Value>** result, int* height, std::exception_ptr* error)
+{
+    try
+    {
+        buildRange(items, lo, hi, parent, threads, result, height);
+    }
+    catch (...)
+    {
+        *error = std::current_exception();
+    }
+}
+
+/*
+ * Removes every item for which pred(item) is true, where item is the
+ * std::pair<const Key, Value>, and returns how many were removed. pred is
+ * called once per item, in key order, before anything is removed, so if
+ * it throws the tree is unchanged. If at least AVL_ERASE_REBUILD_PERCENT
+ * of the items match, the matching nodes are freed and the survivors are
+ * relinked, without copying or allocating, into a perfectly balanced
+ * tree in O(n); otherwise each match is removed on its own in O(log n).
+ */
+template<class Key, class Value>
+template<typename Predicate>
+size_t AVLTree<Key, Value>::eraseIf(Predicate pred)
+{
+    // survivors fill nodes from the front in key order, matches from the back
+    size_t n = this->size_;
+    std::vector<AVLNode<Key, Value>*> nodes(n);
+    size_t kept = 0, erased = 0;
+    // an explicit stack is about twice as fast as following successor()
+    std::vector<AVLNode<Key, Value>*> path;
+    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while (current != nullptr || !path.empty())
+    {
+        for (; current != nullptr; current = current->getLeft()) path.push_back(current);
+        current = path.back();
+        path.pop_back();
+        bool match = pred(current->getItem());
+        nodes[match ? n - 1 - erased : kept] = current;
+        kept += !match;
+        erased += match;
+        current = current->getRight();
+    }
+    if (erased == 0) return 0;
+
+    if (erased * 100 < n * AVL_ERASE_REBUILD_PERCENT)
+    {
+        for (size_t i = kept; i < n; i++)
+        {
+            unlinkNode(nodes[i]);
+            delete nodes[i];
+        }
+        return erased;
+    }
+
+    for (size_t i = kept; i < n; i++) delete nodes[i];
+    AVLNode<Key, Value>* root = nullptr;
+    int height = 0;
+    relinkRange(nodes.data(), 0, kept, nullptr, &root, &height);
+    this->root_ = root;
+    this->size_ = kept;
+    afterStructureChange();
+    return erased;
+}
+
+/*
+ * buildRange for existing nodes: makes the in-order nodes[lo, hi) into a
+ * perfectly balanced subtree under parent and reports its root and height.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::relinkRange(AVLNode<Key, Value>* const* nodes, size_t lo, size_t hi,
+                                      AVLNode<Key, Value>* parent, AVLNode<Key, Value>** result, int* height)
+{
+    if (lo >= hi)
+    {
+        *result = nullptr;
+        *height = 0;
+        return;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    AVLNode<Key, Value>* thisNode = nodes[mid];
+    AVLNode<Key, Value>* left;
+    AVLNode<Key, Value>* right;
+    int leftHeight, rightHeight;
+    relinkRange(nodes, lo, mid, thisNode, &left, &leftHeight);
+    relinkRange(nodes, mid + 1, hi, thisNode, &right, &rightHeight);
+
+    thisNode->setParent(parent);
+    thisNode->setLeft(left);
+    thisNode->setRight(right);
+    thisNode->setBalance(rightHeight - leftHeight);
+    updateNode(thisNode);
+    *result = thisNode;
+    *height = 1 + std::max(leftHeight, rightHeight);
+}
+
+/*
+ * Removes the items in [first, last) and returns last. The range is cut
+ * out with two splits and one join, so this takes O(k + log n) for k
+ * removed items instead of k separate removes.
+ */
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+AVLTree<Key, Value>::erase(typename BinarySearchTree<Key, Value>::iterator first,
+                           typename BinarySearchTree<Key, Value>::iterator last)
+{
+    if (first == last) return last;
+
+    if (last == this->end()) eraseKeys(first->first, nullptr, false);
+    else eraseKeys(first->first, &last->first, false);
+    return last;
+}
+
+/*
+ * Removes every item with lo <= key <= hi in O(k + log n).
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::eraseRange(const Key& lo, const Key& hi)
+{
+    if (hi < lo) return;
+    eraseKeys(lo, &hi, true);
+}
+
+/*
+ * Removes the keys >= lo that are below hi (or up to hi if includeHi, or
+ * with no upper limit if hi is NULL). The tree is split into the parts
+ * before, inside and after the range; the inside part is freed in one
+ * pass and the outer parts are joined back together. lo and hi may refer
+ * to keys inside the tree; they are not used once nodes are freed.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::eraseKeys(const Key& lo, const Key* hi, bool includeHi)
+{
+    if (this->root_ == nullptr) return;
+
+    AVLNode<Key, Value>* before;
+    AVLNode<Key, Value>* rest;
+    AVLNode<Key, Value>* inside;
+    AVLNode<Key, Value>* after = nullptr;
+    int beforeHeight, restHeight, insideHeight, afterHeight = 0;
+
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    this->root_ = nullptr;
+    splitTree(root, subtreeHeight(root), lo, false, &before, &beforeHeight, &rest, &restHeight);
+    if (hi == nullptr)
+    {
+        inside = rest;
+    }
+    else
+    {
+        splitTree(rest, restHeight, *hi, includeHi, &inside, &insideHeight, &after, &afterHeight);
+    }
+    if (inside != nullptr) subtreeErased(inside);
+    this->size_ -= this->clearHelp(inside);
+
+    if (before == nullptr || after == nullptr)
+    {
+        this->root_ = (before != nullptr) ? before : after;
+    }
+    else
+    {
+        // the first node after the range joins the two parts back together
+        AVLNode<Key, Value>* afterRest;
+        int afterRestHeight, height;
+        AVLNode<Key, Value>* pivot = splitFirst(after, afterHeight, &afterRest, &afterRestHeight);
+        this->root_ = joinTrees(before, beforeHeight, pivot, afterRest, afterRestHeight, &height);
+    }
+
+    findRightmost();
+}
+
+/*
+ * Height of a subtree (a leaf is 1), found in O(log n) by following the
+ * taller child as told by the balance factors.
+ */
+template<class Key, class Value>
+int AVLTree<Key, Value>::subtreeHeight(const AVLNode<Key, Value>* thisNode)
+{
+    int height = 0;
+    while (thisNode != nullptr)
+    {
+        height++;
+        thisNode = (thisNode->getBalance() < 0) ? thisNode->getLeft() : thisNode->getRight();
+    }
+    return height;
+}
+
+/*
+ * Splits the detached subtree at thisNode, of the given height, into the
+ * keys that go before key and the rest. With equalLeft a node holding key
+ * goes to the left part, otherwise to the right. Each node on the search
+ * path is reused as the pivot that joins its off-path subtree to one of
+ * the parts, so the whole split takes O(log n).
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::splitTree(AVLNode<Key, Value>* thisNode, int height, const Key& key, bool equalLeft,
+                                    AVLNode<Key, Value>** left, int* leftHeight,
+                                    AVLNode<Key, Value>** right, int* rightHeight)
+{
+    if (thisNode == nullptr)
+    {
+        *left = *right = nullptr;
+        *leftHeight = *rightHeight = 0;
+        return;
+    }
+
+    AVLNode<Key, Value>* leftChild = thisNode->getLeft();
+    AVLNode<Key, Value>* rightChild = thisNode->getRight();
+    int leftChildHeight = (thisNode->getBalance() == 1) ? height - 2 : height - 1;
+    int rightChildHeight = (thisNode->getBalance() == -1) ? height - 2 : height - 1;
+    if (leftChild != nullptr) leftChild->setParent(nullptr);
+    if (rightChild != nullptr) rightChild->setParent(nullptr);
+
+    if (key < thisNode->getKey() || (!equalLeft && !(thisNode->getKey() < key)))
+    {
+        // thisNode and its right subtree go right
+        AVLNode<Key, Value>* middle;
+        int middleHeight;
+        splitTree(leftChild, leftChildHeight, key, equalLeft, left, leftHeight, &middle, &middleHeight);
+        *right = joinTrees(middle, middleHeight, thisNode, rightChild, rightChildHeight, rightHeight);
+    }
+    else
+    {
+        AVLNode<Key, Value>* middle;
+        int middleHeight;
+        splitTree(rightChild, rightChildHeight, key, equalLeft, &middle, &middleHeight, right, rightHeight);
+        *left = joinTrees(leftChild, leftChildHeight, thisNode, middle, middleHeight, leftHeight);
+    }
+}
+
+/*
+ * Detaches and returns the node with the smallest key of the detached
+ * subtree at thisNode; the remaining nodes are returned in rest.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::splitFirst(AVLNode<Key, Value>* thisNode, int height,
+                                                     AVLNode<Key, Value>** rest, int* restHeight)
+{
+    AVLNode<Key, Value>* leftChild = thisNode->getLeft();
+    AVLNode<Key, Value>* rightChild = thisNode->getRight();
+    if (rightChild != nullptr) rightChild->setParent(nullptr);
+    if (leftChild == nullptr)
+    {
+        *rest = rightChild;
+        *restHeight = height - 1;
+        return thisNode;
+    }
+    leftChild->setParent(nullptr);
+
+    int leftChildHeight = (thisNode->getBalance() == 1) ? height - 2 : height - 1;
+    int rightChildHeight = (thisNode->getBalance() == -1) ? height - 2 : height - 1;
+    AVLNode<Key, Value>* leftRest;
+    int leftRestHeight;
+    AVLNode<Key, Value>* first = splitFirst(leftChild, leftChildHeight, &leftRest, &leftRestHeight);
+    *rest = joinTrees(leftRest, leftRestHeight, thisNode, rightChild, rightChildHeight, restHeight);
+    return first;
+}
+
+/*
+ * Joins two detached subtrees and a pivot node, where every key in left
+ * is below the pivot's and every key in right above it, into one AVL
+ * subtree. The pivot is hung off the spine of the taller tree where the
+ * heights meet, then the usual insert rebalancing runs above it, so this
+ * takes O(|leftHeight - rightHeight| + 1). Returns the new subtree root
+ * and its height.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinTrees(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* pivot,
+                                                    AVLNode<Key, Value>* right, int rightHeight, int* height)
+{
+    pivot->setParent(nullptr);
+    if (leftHeight - rightHeight <= 1 && rightHeight - leftHeight <= 1)
+    {
+        pivot->setLeft(left);
+        pivot->setRight(right);
+        if (left != nullptr) left->setParent(pivot);
+        if (right != nullptr) right->setParent(pivot);
+        pivot->setBalance(rightHeight - leftHeight);
+        updateNode(pivot);
+        *height = 1 + std::max(leftHeight, rightHeight);
+        return pivot;
+    }
+
+    bool leftTaller = leftHeight > rightHeight;
+    AVLNode<Key, Value>* top = leftTaller ? left : right;
+    int topHeight = leftTaller ? leftHeight : rightHeight;
+    int shortHeight = leftTaller ? rightHeight : leftHeight;
+    int8_t topBalance = top->getBalance();
+
+    // walk down the inner spine of the taller tree to the first subtree
+    // no more than one level taller than the shorter tree
+    AVLNode<Key, Value>* parent = nullptr;
+    AVLNode<Key, Value>* spineNode = top;
+    int spineHeight = topHeight;
+    while (spineHeight > shortHeight + 1)
+    {
+        parent = spineNode;
+        if (leftTaller)
+        {
+            spineHeight -= (spineNode->getBalance() == -1) ? 2 : 1;
+            spineNode = spineNode->getRight();
+        }
+        else
+        {
+            spineHeight -= (spineNode->getBalance() == 1) ? 2 : 1;
+            spineNode = spineNode->getLeft();
+        }
+    }
+
+    // the pivot takes the spine subtree's place, one level taller than it
+    pivot->setParent(parent);
+    if (leftTaller)
+    {
+        pivot->setLeft(spineNode);
+        pivot->setRight(right);
+        if (right != nullptr) right->setParent(pivot);
+        pivot->setBalance(shortHeight - spineHeight);
+        parent->setRight(pivot);
+    }
+    else
+    {
+        pivot->setLeft(left);
+        pivot->setRight(spineNode);
+        if (left != nullptr) left->setParent(pivot);
+        pivot->setBalance(spineHeight - shortHeight);
+        parent->setLeft(pivot);
+    }
+    if (spineNode != nullptr) spineNode->setParent(pivot);
+    updatePath(pivot);
+
+    // rotations at the top of a detached subtree record the new top in root_
+    Node<Key, Value>* savedRoot = this->root_;
+    this->root_ = top;
+    insertFix(pivot, spineNode);
+    AVLNode<Key, Value>* result = static_cast<AVLNode<Key, Value>*>(this->root_);
+    this->root_ = savedRoot;
+
+    // the subtree only grew if the growth reached an evenly balanced top
+    bool grew = result == top && topBalance == 0 && top->getBalance() != 0;
+    *height = topHeight + (grew ? 1 : 0);
+    return result;
+}
+
+/*
+ * Size of the node type allocated by createNode(), for memoryUsage().
+ */
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::nodeBytes() const
+{
+    return sizeof(AVLNode<Key, Value>);
+}
+
+template<class Key, class Value>
+const std::type_info& AVLTree<Key, Value>::nodeType() const
+{
+    return typeid(AVLNode<Key, Value>);
+}
+
+/*
+ * Allocates the node type used by this tree.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new AVLNode<Key, Value>(key, value, parent);
+}
+
+/*
+ * Recomputes any per-node data of thisNode from its children.
+ * Called after rotations; a plain AVLTree keeps nothing extra.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::updateNode(AVLNode<Key,Value>* thisNode)
+{
+
+}
+
+/*
+ * Recomputes per-node data from thisNode up to the root, after the
+ * contents of thisNode's subtree changed.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::updatePath(AVLNode<Key,Value>* thisNode)
+{
+
+}
+
 template<class Key, class Value>
 void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
@@ -619,6 +1539,7 @@ void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>*
 template<class Key, class Value>
 void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* grandParent)
 {
+    BST_LATENCY_ROTATION();
     AVLNode<Key, Value>* parent = grandParent->getRight();
     AVLNode<Key, Value>* parentOriginalLeft = parent->getLeft();
     parent->setLeft(grandParent);
@@ -637,11 +1558,14 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* grandParent)
         this->root_ = parent;
     }
     grandParent->setParent(parent);
+    updateNode(grandParent);
+    updateNode(parent);
 }
 
 template<class Key, class Value>
 void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* grandParent)
 {
+    BST_LATENCY_ROTATION();
     AVLNode<Key, Value>* parent = grandParent->getLeft();
     AVLNode<Key, Value>* parentOriginalRight = parent->getRight();
     parent->setRight(grandParent);
@@ -660,7 +1584,19 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* grandParent)
         this->root_ = parent;
     }
     grandParent->setParent(parent);
+    updateNode(grandParent);
+    updateNode(parent);
 }
 
 
+/**
+* Removes every item of tree for which pred(item) is true and returns how
+* many were removed, like std::erase_if. See AVLTree::eraseIf.
+*/
+template<class Key, class Value, typename Predicate>
+size_t erase_if(AVLTree<Key, Value>& tree, Predicate pred)
+{
+    return tree.eraseIf(pred);
+}
+
 #endif
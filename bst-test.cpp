@@ -1,10 +1,1165 @@
 #include <iostream>
 #include <map>
+#include <string>
+#include <sstream>
+#include <limits>
+#include <vector>
 #include "bst.h"
 #include "avlbst.h"
+#include "filterbst.h"
+#include "durablebst.h"
+#include "augmentedbst.h"
+#include "splaybst.h"
+#include "intervalbst.h"
+#include "adaptivebst.h"
+#include "pooledbst.h"
+#include "tracedbst.h"
+#include <csignal>
+#include <sys/resource.h>
 
 using namespace std;
 
+static int failures = 0;
+
+static void check(bool ok, const char* msg)
+{
+    cout << msg << ": " << (ok ? "pass" : "FAIL") << endl;
+    if (!ok) failures++;
+}
+
+// tree holds exactly the items of expected, in order, and its links,
+// balance factors and size are consistent
+template<typename Tree, typename Map>
+static bool matches(const Tree& tree, const Map& expected)
+{
+    ValidationReport report = tree.validate(1);
+    if (!report.ok() || !tree.isBalanced() || report.nodeCount != expected.size()) return false;
+    if (tree.size() != expected.size()) return false;
+    typename Tree::iterator it = tree.begin();
+    for (typename Map::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it)
+    {
+        if (it == tree.end() || !(it->first == e->first) || !(it->second == e->second)) return false;
+    }
+    return it == tree.end();
+}
+
+// Keys added or removed through AVLTree/BinarySearchTree references must
+// still reach the filter: a Bloom front may never report a present key as absent.
+void testFilterThroughBase(const char* msg)
+{
+    FilteredAVLTree<int, int> tree;
+    AVLTree<int, int>& avl = tree;
+    BinarySearchTree<int, int>& bst = tree;
+    map<int, int> expected;
+
+    for (int i = 0; i < 200; i += 2)
+    {
+        avl.insert(make_pair(i, i));
+        expected[i] = i;
+    }
+    BinarySearchTree<int, int>::iterator hint = bst.find(100);
+    avl.insert(hint, make_pair(101, 101));
+    expected[101] = 101;
+
+    vector<pair<int, int> > items;
+    for (int i = 1000; i < 1100; i++) items.push_back(make_pair(i, i));
+    AVLTree<int, int> other;
+    other.bulkBuild(items, 1);
+    bst.merge(other);
+    for (int i = 1000; i < 1100; i++) expected[i] = i;
+
+    avl.eraseRange(10, 50);
+    expected.erase(expected.lower_bound(10), expected.upper_bound(50));
+    avl.erase(avl.find(60), avl.find(80));
+    expected.erase(expected.find(60), expected.find(80));
+
+    bool allFound = true;
+    for (map<int, int>::iterator it = expected.begin(); it != expected.end(); ++it)
+    {
+        allFound = allFound && tree.contains(it->first) && tree.get(it->first) != nullptr
+                   && tree.find(it->first) != tree.end() && tree[it->first] == it->second;
+    }
+    check(allFound && matches(tree, expected), msg);
+
+    avl.bulkBuild(items, 1);
+    bool rebuilt = true;
+    for (int i = 1000; i < 1100; i++) rebuilt = rebuilt && tree.contains(i);
+    check(rebuilt && !tree.contains(0), "filter after bulkBuild through base");
+
+    bst.clear();
+    bst.insert(make_pair(7, 7));
+    check(tree.contains(7) && !tree.contains(1000) && tree.size() == 1, "filter after clear through base");
+}
+
+// Nodes only move between trees with the same node type; anything else
+// throws and leaves both trees as they were.
+void testNodeKinds(const char* msg)
+{
+    AVLTree<int, int> avl;
+    AugmentedAVLTree<int, int, SumAugment<int> > sums;
+    SplayTree<int, int> splay;
+    map<int, int> avlItems, sumItems;
+    for (int i = 0; i < 20; i++)
+    {
+        avl.insert(make_pair(i, i));
+        avlItems[i] = i;
+        sums.insert(make_pair(i + 100, 1));
+        sumItems[i + 100] = 1;
+    }
+    BinarySearchTree<int, int>& avlBase = avl;
+    BinarySearchTree<int, int>& sumsBase = sums;
+    BinarySearchTree<int, int>& splayBase = splay;
+
+    int rejected = 0;
+    try { avlBase.merge(sumsBase); } catch (const std::invalid_argument&) { rejected++; }
+    try { splayBase.merge(avlBase); } catch (const std::invalid_argument&) { rejected++; }
+    try { avlBase = sumsBase; } catch (const std::invalid_argument&) { rejected++; }
+    try { sumsBase = std::move(avlBase); } catch (const std::invalid_argument&) { rejected++; }
+    try { avlBase.swap(sumsBase); } catch (const std::invalid_argument&) { rejected++; }
+
+    AVLTree<int, int>::NodeHandle handle = sums.extract(105);
+    sumItems.erase(105);
+    try { avl.insert(std::move(handle)); } catch (const std::invalid_argument&) { rejected++; }
+    bool kept = !handle.empty() && handle.key() == 105;
+
+    // same node type: the handle and merge go through
+    AVLTree<int, int> other;
+    other.insert(make_pair(50, 50));
+    other.insert(make_pair(3, -3));
+    avl.insert(other.extract(50));
+    avl.merge(other);
+    avlItems[50] = 50;
+
+    check(rejected == 6 && kept && splay.empty() && matches(avl, avlItems) && matches(sums, sumItems)
+          && sums.aggregate() == (int)sumItems.size() && other.size() == 1, msg);
+}
+
+// Intervals sharing a start point are kept apart; queries report each
+// overlapping one in key order, also on a tree too deep for recursion.
+void testIntervalDuplicateStarts(const char* msg)
+{
+    IntervalTree<int, int> tree;
+    tree.insert(5, 6, 1);
+    tree.insert(5, 20, 2);
+    tree.insert(5, 9, 3);
+    tree.insert(1, 4, 4);
+    tree.insert(12, 15, 5);
+    tree.insert(5, 9, 6); // same interval: replaces the value
+
+    vector<IntervalTree<int, int>::iterator> found;
+    tree.stabbing(8, found);
+    bool stab = found.size() == 2 && found[0]->first == IntervalKey<int>(5, 9) && found[0]->second.value == 6
+                && found[1]->first == IntervalKey<int>(5, 20);
+
+    tree.remove(5, 20);
+    found.clear();
+    tree.overlapping(6, 13, found);
+    bool overlap = tree.size() == 4 && found.size() == 3 && found[0]->first == IntervalKey<int>(5, 6)
+                   && found[1]->first == IntervalKey<int>(5, 9) && found[2]->first == IntervalKey<int>(12, 15);
+
+    IntervalTree<int, int> nested;
+    for (int i = 0; i < 100000; i++) nested.insert(i, 200000 - i, i);
+    found.clear();
+    nested.stabbing(100000, found);
+    check(stab && overlap && found.size() == 100000 && tree.isBalanced() && nested.isBalanced(), msg);
+}
+
+// JSON export writes small integers as numbers, non-finite doubles as
+// null and bools as true/false; sampling and the budget bound the output.
+void testExportJson(const char* msg)
+{
+    AVLTree<int8_t, double> numbers;
+    numbers.insert(make_pair((int8_t)-3, 0.1));
+    numbers.insert(make_pair((int8_t)65, std::numeric_limits<double>::quiet_NaN()));
+    numbers.insert(make_pair((int8_t)7, -std::numeric_limits<double>::infinity()));
+    ostringstream json;
+    numbers.exportJson(json);
+    string text = json.str();
+    bool scalars = text.find("\"key\": 7, \"value\": null") != string::npos
+                   && text.find("\"key\": -3, \"value\": 0.10000000000000001") != string::npos
+                   && text.find("\"key\": 65, \"value\": null") != string::npos && text.find("nan") == string::npos
+                   && text.find("inf") == string::npos;
+
+    AVLTree<uint8_t, bool> flags;
+    flags.insert(make_pair((uint8_t)200, true));
+    flags.insert(make_pair((uint8_t)1, false));
+    ostringstream flagJson;
+    flags.exportJson(flagJson);
+    bool bools = flagJson.str().find("\"key\": 200, \"value\": true") != string::npos
+                 && flagJson.str().find("\"key\": 1, \"value\": false") != string::npos;
+
+    AVLTree<int, int> large;
+    for (int i = 0; i < 4095; i++) large.insert(make_pair(i, i));
+    size_t counts[3];
+    bool pathsToLeaves = true;
+    for (int run = 0; run < 3; run++)
+    {
+        ExportOptions<int> options;
+        if (run == 1) options.sample(2);
+        if (run == 2) options.maxNodes = 100;
+        ostringstream out;
+        large.exportJson(out, options);
+        string exported = out.str();
+        counts[run] = 0;
+        for (size_t pos = exported.find("\"id\""); pos != string::npos; pos = exported.find("\"id\"", pos + 1)) counts[run]++;
+        if (run == 1) pathsToLeaves = exported.find("\"left\": null, \"right\": null, \"truncated\": true") == string::npos;
+    }
+    // sampling half the links of a 12-level perfect tree keeps a few paths
+    // per level, each down to a leaf
+    check(scalars && bools && counts[0] == 4095 && counts[1] > 12 && counts[1] < 1000 && pathsToLeaves
+          && counts[2] == 100, msg);
+}
+
+// Copies, moves and swaps through BinarySearchTree references keep
+// AVLTree's rightmost finger and FilteredAVLTree's filter in step with
+// the nodes; the appends after each one go through the finger.
+void testCopyMoveSwap(const char* msg)
+{
+    AVLTree<int, int> a, b, c;
+    map<int, int> aItems, bItems, cItems;
+    for (int i = 0; i < 100; i++)
+    {
+        a.insert(make_pair(i, i));
+        aItems[i] = i;
+    }
+    for (int i = 1000; i < 1050; i++)
+    {
+        b.insert(make_pair(i, -i));
+        bItems[i] = -i;
+    }
+    c.insert(make_pair(7, 7));
+    cItems[7] = 7;
+    BinarySearchTree<int, int>& baseA = a;
+    BinarySearchTree<int, int>& baseB = b;
+    BinarySearchTree<int, int>& baseC = c;
+
+    baseA.swap(baseB);
+    std::swap(aItems, bItems);
+    a.insert(make_pair(5000, 1));
+    aItems[5000] = 1;
+    b.insert(make_pair(500, 2));
+    bItems[500] = 2;
+    bool swapped = matches(a, aItems) && matches(b, bItems);
+
+    baseA = baseC;
+    aItems = cItems;
+    a.insert(make_pair(8, 8));
+    aItems[8] = 8;
+    bool copied = matches(a, aItems) && matches(c, cItems);
+
+    baseA = std::move(baseB);
+    aItems = bItems;
+    a.insert(make_pair(6000, 3));
+    aItems[6000] = 3;
+    b.insert(make_pair(1, 1));
+    bool moved = matches(a, aItems) && b.size() == 1 && b.isBalanced();
+
+    AVLTree<int, int> copy(a), stolen(std::move(c));
+    copy.insert(make_pair(7000, 4));
+    stolen.insert(make_pair(9, 9));
+    aItems[7000] = 4;
+    cItems[9] = 9;
+    bool constructed = matches(copy, aItems) && matches(stolen, cItems) && c.empty();
+
+    FilteredAVLTree<int, int> f, g;
+    AVLTree<int, int> plain;
+    for (int i = 0; i < 300; i++) f.insert(make_pair(i, i));
+    for (int i = 300; i < 310; i++) g.insert(make_pair(i, i));
+    plain.insert(make_pair(-1, -1));
+    BinarySearchTree<int, int>& baseF = f;
+    BinarySearchTree<int, int>& baseG = g;
+    baseF.swap(baseG);
+    bool filters = g.contains(299) && f.contains(305) && !f.contains(0);
+    baseF.swap(plain);
+    filters = filters && f.contains(-1) && !f.contains(305) && plain.contains(305);
+    baseF = baseG;
+    FilteredAVLTree<int, int> h(std::move(g));
+    filters = filters && f.contains(150) && h.contains(150) && g.empty() && !g.contains(150);
+    g = std::move(h);
+    for (int i = 0; i < 300; i++) filters = filters && f.contains(i) && g.contains(i) && !h.contains(i);
+
+    SplayTree<int, int> semi(true), full;
+    BinarySearchTree<int, int>& baseSemi = semi;
+    baseSemi.swap(full);
+    bool splayMode = !semi.isSemiSplay() && full.isSemiSplay();
+
+    check(swapped && copied && moved && constructed && filters && splayMode, msg);
+}
+
+// copies every value, throwing once the budget runs out
+struct Fragile
+{
+    static int budget;
+
+    Fragile(int v = 0) : value(v) { }
+    Fragile(const Fragile& other) : value(other.value)
+    {
+        if (budget-- == 0) throw std::bad_alloc();
+    }
+    Fragile& operator=(const Fragile& other)
+    {
+        value = other.value;
+        return *this;
+    }
+
+    int value;
+};
+int Fragile::budget = -1;
+
+ostream& operator<<(ostream& os, const Fragile& item)
+{
+    return os << item.value;
+}
+
+// gives the test the parallel copy without depending on the core count
+struct CloneProbe : public AVLTree<int, Fragile>
+{
+    using AVLTree<int, Fragile>::cloneParallel;
+    using AVLTree<int, Fragile>::root_;
+};
+
+// A copy that runs out of memory part way, on any thread, frees what it
+// copied and throws on the caller; the source is untouched.
+void testCopyThrows(const char* msg)
+{
+    CloneProbe source;
+    for (int i = 0; i < 5000; i++) source.insert(make_pair(i, Fragile(i)));
+
+    int caught = 0;
+    int budgets[3] = { 10, 2600, 4990 }; // left side, right side, last nodes
+    for (int i = 0; i < 3; i++)
+    {
+        Fragile::budget = budgets[i];
+        Node<int, Fragile>* copy = nullptr;
+        try
+        {
+            CloneProbe::cloneParallel(source.root_, nullptr, 4, &copy);
+        }
+        catch (const std::bad_alloc&)
+        {
+            caught++;
+        }
+        if (copy != nullptr) caught = -100;
+    }
+
+    Fragile::budget = 100;
+    AVLTree<int, Fragile> target;
+    target.insert(make_pair(1, Fragile(1)));
+    try
+    {
+        target = source;
+    }
+    catch (const std::bad_alloc&)
+    {
+        caught++;
+    }
+    Fragile::budget = -1;
+    target.insert(make_pair(3, Fragile(3)));
+    check(caught == 4 && source.size() == 5000 && source.isBalanced() && target.size() == 1, msg);
+}
+
+// hangs a three-node chain whose balance factors match its heights
+struct ChainedAVLTree : public AVLTree<int, int>
+{
+    void makeChain()
+    {
+        clear();
+        AVLNode<int, int>* top = new AVLNode<int, int>(1, 1, nullptr);
+        AVLNode<int, int>* middle = new AVLNode<int, int>(2, 2, top);
+        AVLNode<int, int>* bottom = new AVLNode<int, int>(3, 3, middle);
+        top->setRight(middle);
+        middle->setRight(bottom);
+        top->setBalance(2);
+        middle->setBalance(1);
+        root_ = top;
+        size_ = 3;
+    }
+};
+
+// A chain is a valid plain BST but not a valid AVL tree, even with
+// consistent balance factors.
+void testValidateBalance(const char* msg)
+{
+    BinarySearchTree<int, int> plain;
+    for (int i = 1; i <= 3; i++) plain.insert(make_pair(i, i));
+    ChainedAVLTree chain;
+    chain.makeChain();
+    ValidationReport plainReport = plain.validate(1), chainReport = chain.validate(1);
+    check(plainReport.ok() && !plainReport.heightBalanced && chainReport.balanceFactorsCorrect
+          && !chainReport.heightBalanced && !chainReport.ok(), msg);
+}
+
+// Range erase splits and joins; every cut must leave exactly the items
+// outside the range in a balanced tree, at the edges and in the middle.
+void testEraseRanges(const char* msg)
+{
+    AVLTree<int, int> tree;
+    map<int, int> expected;
+    for (int i = 0; i < 500; i++)
+    {
+        int key = (i * 37) % 500 * 2;
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+
+    bool ok = matches(tree, expected);
+    // inclusive [lo, hi]: empty, reversed, one key, gaps between keys, prefix, suffix, middle
+    int ranges[][2] = { { 1, 1 }, { 30, 20 }, { 100, 100 }, { 201, 203 }, { -50, 40 },
+                        { 950, 2000 }, { 300, 500 }, { 299, 501 }, { 620, 780 } };
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++)
+    {
+        int lo = ranges[i][0], hi = ranges[i][1];
+        tree.eraseRange(lo, hi);
+        if (!(hi < lo)) expected.erase(expected.lower_bound(lo), expected.upper_bound(hi));
+        ok = ok && matches(tree, expected);
+    }
+
+    // half-open [first, last) by iterator: empty, middle, up to end, from begin
+    int bounds[][2] = { { 120, 120 }, { 44, 90 }, { 860, -1 }, { -1, 96 } };
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(bounds[0]); i++)
+    {
+        AVLTree<int, int>::iterator first = bounds[i][0] < 0 ? tree.begin() : tree.find(bounds[i][0]);
+        AVLTree<int, int>::iterator last = bounds[i][1] < 0 ? tree.end() : tree.find(bounds[i][1]);
+        map<int, int>::iterator mapFirst = bounds[i][0] < 0 ? expected.begin() : expected.find(bounds[i][0]);
+        map<int, int>::iterator mapLast = bounds[i][1] < 0 ? expected.end() : expected.find(bounds[i][1]);
+        AVLTree<int, int>::iterator next = tree.erase(first, last);
+        expected.erase(mapFirst, mapLast);
+        ok = ok && matches(tree, expected) && (bounds[i][1] < 0 ? next == tree.end() : next->first == bounds[i][1]);
+    }
+
+    // the tree keeps working after the cuts
+    for (int key = 1; key < 1000; key += 50)
+    {
+        tree.insert(make_pair(key, -key));
+        expected[key] = -key;
+    }
+    ok = ok && matches(tree, expected);
+
+    tree.erase(tree.begin(), tree.end());
+    expected.clear();
+    ok = ok && matches(tree, expected) && tree.empty();
+    tree.insert(make_pair(5, 5));
+    tree.eraseRange(numeric_limits<int>::min(), numeric_limits<int>::max());
+    check(ok && tree.empty() && tree.validate(1).ok(), msg);
+}
+
+// the tree matches expected and its aggregate over every range with ends
+// in [-2, limit] equals the policy folded over the same items of expected
+template<typename Tree, typename Policy>
+static bool aggregatesMatch(const Tree& tree, const map<int, int>& expected, int limit)
+{
+    if (!matches(tree, expected)) return false;
+    typename Policy::value_type all = Policy::identity();
+    for (map<int, int>::const_iterator it = expected.begin(); it != expected.end(); ++it)
+    {
+        all = Policy::combine(all, Policy::lift(it->second));
+    }
+    if (!(tree.aggregate() == all)) return false;
+
+    for (int lo = -2; lo <= limit; lo += 7)
+    {
+        for (int hi = lo - 1; hi <= limit; hi += 5)
+        {
+            typename Policy::value_type folded = Policy::identity();
+            for (map<int, int>::const_iterator it = expected.lower_bound(lo); it != expected.end() && it->first <= hi; ++it)
+            {
+                folded = Policy::combine(folded, Policy::lift(it->second));
+            }
+            if (!(tree.aggregate(lo, hi) == folded)) return false;
+        }
+    }
+    return true;
+}
+
+// Subtree aggregates follow inserts, overwrites, removes, range erases
+// and rotations; every range query is checked against a brute-force fold.
+template<typename Policy>
+static bool checkAggregates()
+{
+    AugmentedAVLTree<int, int, Policy> tree;
+    map<int, int> expected;
+    bool ok = aggregatesMatch<AugmentedAVLTree<int, int, Policy>, Policy>(tree, expected, 20);
+    for (int i = 0; i < 200; i++)
+    {
+        int key = (i * 53) % 200;
+        int value = (i * 31) % 97 - 40;
+        tree.insert(make_pair(key, value));
+        expected[key] = value;
+        if (i % 20 == 19) ok = ok && aggregatesMatch<AugmentedAVLTree<int, int, Policy>, Policy>(tree, expected, 210);
+    }
+    for (int key = 0; key < 200; key += 9)
+    {
+        tree.insert(make_pair(key, key - 100));
+        expected[key] = key - 100;
+    }
+    ok = ok && aggregatesMatch<AugmentedAVLTree<int, int, Policy>, Policy>(tree, expected, 210);
+    for (int i = 0; i < 120; i++)
+    {
+        int key = (i * 71) % 200;
+        tree.remove(key);
+        expected.erase(key);
+        if (i % 15 == 14) ok = ok && aggregatesMatch<AugmentedAVLTree<int, int, Policy>, Policy>(tree, expected, 210);
+    }
+    tree.eraseRange(40, 90);
+    expected.erase(expected.lower_bound(40), expected.upper_bound(90));
+    return ok && aggregatesMatch<AugmentedAVLTree<int, int, Policy>, Policy>(tree, expected, 210);
+}
+
+void testAggregates(const char* msg)
+{
+    check(checkAggregates<SumAugment<int> >() && checkAggregates<MinAugment<int> >()
+          && checkAggregates<MaxAugment<int> >(), msg);
+}
+
+// A node moved by a handle or merge arrives with the aggregate of its old
+// subtree; the receiving tree must recompute it, empty or not.
+void testMovedAggregates(const char* msg)
+{
+    typedef AugmentedAVLTree<int, int, SumAugment<int> > SumTree;
+    typedef SumAugment<int> Sum;
+    SumTree a, b, c;
+    map<int, int> aItems, bItems, cItems;
+    for (int i = 0; i < 7; i++)
+    {
+        a.insert(make_pair(i, 10));
+        aItems[i] = 10;
+    }
+
+    // the root of a, whose aggregate covers all seven items
+    b.insert(a.extract(3));
+    aItems.erase(3);
+    bItems[3] = 10;
+    bool ok = b.aggregate() == 10 && aggregatesMatch<SumTree, Sum>(b, bItems, 8)
+              && aggregatesMatch<SumTree, Sum>(a, aItems, 8);
+    b.insert(a.extract(1));
+    aItems.erase(1);
+    bItems[1] = 10;
+    ok = ok && aggregatesMatch<SumTree, Sum>(b, bItems, 8) && aggregatesMatch<SumTree, Sum>(a, aItems, 8);
+
+    c.merge(a);
+    cItems = aItems;
+    aItems.clear();
+    ok = ok && aggregatesMatch<SumTree, Sum>(c, cItems, 8) && a.empty() && a.aggregate() == 0;
+    b.merge(c);
+    bItems.insert(cItems.begin(), cItems.end());
+    ok = ok && aggregatesMatch<SumTree, Sum>(b, bItems, 8) && c.empty();
+
+    // interval trees keep the largest end of each subtree the same way
+    IntervalTree<int, int> intervals, empty, other;
+    for (int i = 0; i < 7; i++) intervals.insert(i, i + 100, i);
+    BinarySearchTree<IntervalKey<int>, IntervalValue<int, int> >& emptyBase = empty;
+    emptyBase.insert(intervals.extract(IntervalKey<int>(3, 103)));
+    ok = ok && empty.aggregate() == 103 && empty.isBalanced();
+    emptyBase.insert(intervals.extract(IntervalKey<int>(1, 101)));
+    ok = ok && empty.aggregate() == 103 && intervals.aggregate() == 106;
+    other.insert(0, 1, 0);
+    other.merge(intervals);
+    vector<IntervalTree<int, int>::iterator> found;
+    other.stabbing(105, found);
+    check(ok && other.aggregate() == 106 && other.size() == 6 && found.size() == 2 && other.isBalanced()
+          && intervals.empty(), msg);
+}
+
+// map-like containers without iterators: forEach visits exactly the items
+// of expected in order, and lookups and size agree
+template<typename Tree>
+static bool sameItems(const Tree& tree, const map<int, int>& expected)
+{
+    if (tree.size() != expected.size() || tree.empty() != expected.empty()) return false;
+    vector<pair<int, int> > visited, items(expected.begin(), expected.end());
+    tree.forEach([&visited](const int& key, const int& value) { visited.push_back(make_pair(key, value)); });
+    if (visited != items) return false;
+    for (int key = -1; key <= 100; key++)
+    {
+        map<int, int>::const_iterator it = expected.find(key);
+        const int* value = tree.get(key);
+        if (it == expected.end() ? value != nullptr || tree.contains(key) : value == nullptr || *value != it->second) return false;
+    }
+    return true;
+}
+
+// The array form turns into a tree on the insert past 32 items and back
+// on the remove below 16; the items must survive both moves and the
+// map must work the same in either form.
+void testAdaptiveThresholds(const char* msg)
+{
+    AdaptiveAVLTree<int, int> tree;
+    map<int, int> expected;
+    bool ok = sameItems(tree, expected);
+    for (int i = 0; i < ADAPTIVE_PROMOTE_SIZE; i++)
+    {
+        int key = (i * 13) % 64 + 1;
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+        ok = ok && !tree.isPromoted() && sameItems(tree, expected);
+    }
+    tree.insert(make_pair(1, -1)); // overwrite at full size stays an array
+    expected[1] = -1;
+    ok = ok && !tree.isPromoted() && sameItems(tree, expected);
+
+    tree.insert(make_pair(0, 100)); // new smallest key goes in during the promotion
+    expected[0] = 100;
+    bool promoted = tree.isPromoted() && sameItems(tree, expected);
+    tree.insert(make_pair(70, 70));
+    expected[70] = 70;
+    tree.remove(99); // absent
+    promoted = promoted && tree.isPromoted() && sameItems(tree, expected);
+
+    // down to ADAPTIVE_DEMOTE_SIZE items it stays a tree
+    while (expected.size() > ADAPTIVE_DEMOTE_SIZE)
+    {
+        map<int, int>::iterator victim = expected.begin();
+        advance(victim, expected.size() / 3);
+        tree.remove(victim->first);
+        expected.erase(victim);
+        promoted = promoted && tree.isPromoted() && sameItems(tree, expected);
+    }
+    int removed = expected.rbegin()->first;
+    tree.remove(removed);
+    expected.erase(removed);
+    bool demoted = !tree.isPromoted() && sameItems(tree, expected);
+
+    // and grows back through the same thresholds
+    for (int key = 0; expected.size() < ADAPTIVE_PROMOTE_SIZE; key += 3)
+    {
+        tree.insert(make_pair(key, key * 2));
+        expected[key] = key * 2;
+        demoted = demoted && !tree.isPromoted() && sameItems(tree, expected);
+    }
+    tree.insert(make_pair(98, 98)); // new largest key
+    expected[98] = 98;
+    bool again = tree.isPromoted() && sameItems(tree, expected);
+    tree.clear();
+    expected.clear();
+    again = again && !tree.isPromoted() && sameItems(tree, expected);
+    check(ok && promoted && demoted && again, msg);
+}
+
+// Pooled nodes are rebalanced by index and freed slots are reused; the
+// items and balance must hold through inserts, removes of nodes with
+// two children (which take over a predecessor's slot) and refills.
+void testPooledUpdates(const char* msg)
+{
+    PooledAVLTree<int, int> tree;
+    map<int, int> expected;
+    bool ok = sameItems(tree, expected) && tree.isBalanced();
+    for (int i = 0; i < 100; i++)
+    {
+        int key = (i * 41) % 100;
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+        ok = ok && tree.isBalanced() && sameItems(tree, expected);
+    }
+    for (int i = 0; i < 100; i += 3)
+    {
+        tree.insert(make_pair(i, -i)); // overwrite
+        expected[i] = -i;
+    }
+    ok = ok && tree.isBalanced() && sameItems(tree, expected);
+
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = 0; i < 60; i++)
+        {
+            int key = (i * 29 + round * 7) % 100;
+            tree.remove(key);
+            expected.erase(key);
+            ok = ok && tree.isBalanced() && sameItems(tree, expected);
+        }
+        tree.remove(-1); // absent
+        for (int i = 0; i < 50; i++)
+        {
+            int key = (i * 17 + round) % 100;
+            tree.insert(make_pair(key, key + round * 1000));
+            expected[key] = key + round * 1000;
+            ok = ok && tree.isBalanced() && sameItems(tree, expected);
+        }
+    }
+
+    while (!expected.empty())
+    {
+        map<int, int>::iterator victim = expected.begin();
+        advance(victim, expected.size() / 2);
+        tree.remove(victim->first);
+        expected.erase(victim);
+        ok = ok && tree.isBalanced() && sameItems(tree, expected);
+    }
+    tree.insert(make_pair(50, 5));
+    expected[50] = 5;
+    ok = ok && sameItems(tree, expected);
+    tree.clear();
+    expected.clear();
+    ok = ok && sameItems(tree, expected) && tree.isBalanced();
+
+    // a value whose copy throws leaves the pool as it was
+    PooledAVLTree<int, Fragile> fragile;
+    for (int i = 0; i < 10; i++) fragile.insert(make_pair(i, Fragile(i)));
+    pair<const int, Fragile> item(10, Fragile(10));
+    Fragile::budget = 0;
+    try { fragile.insert(item); ok = false; } catch (const std::bad_alloc&) { }
+    Fragile::budget = -1;
+    fragile.remove(4);
+    fragile.insert(make_pair(11, Fragile(11)));
+    fragile.insert(make_pair(12, Fragile(12)));
+    vector<pair<int, int> > items;
+    fragile.forEach([&items](const int& key, const Fragile& value) { items.push_back(make_pair(key, value.value)); });
+    ok = ok && fragile.size() == 11 && items.size() == 11 && fragile.isBalanced() && !fragile.contains(10);
+    for (size_t i = 0; i < items.size(); i++) ok = ok && items[i].first == items[i].second;
+    check(ok, msg);
+}
+
+struct DivisibleBy
+{
+    explicit DivisibleBy(int d) : divisor(d) { }
+    bool operator()(const pair<const int, int>& item) const { return item.first % divisor == 0; }
+    int divisor;
+};
+
+struct ThrowAt
+{
+    bool operator()(const pair<const int, int>& item) const
+    {
+        if (item.first == 150) throw std::runtime_error("predicate");
+        return item.first % 2 == 0;
+    }
+};
+
+// removes the items of expected matching pred and returns how many
+template<typename Predicate>
+static size_t eraseExpected(map<int, int>& expected, Predicate pred)
+{
+    size_t erased = 0;
+    for (map<int, int>::iterator it = expected.begin(); it != expected.end();)
+    {
+        if (pred(*it))
+        {
+            expected.erase(it++);
+            erased++;
+        }
+        else ++it;
+    }
+    return erased;
+}
+
+// Few matches are removed one by one, many by relinking the survivors;
+// both must leave the same items in a balanced tree, keep aggregates
+// right, and leave the tree untouched when the predicate throws.
+void testEraseIf(const char* msg)
+{
+    AVLTree<int, int> tree;
+    AugmentedAVLTree<int, int, SumAugment<int> > sums;
+    map<int, int> expected;
+    for (int i = 0; i < 300; i++)
+    {
+        int key = (i * 7) % 300;
+        tree.insert(make_pair(key, i));
+        sums.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+
+    // ThrowAt would remove half the items, but throws before anything is removed
+    bool threw = false;
+    try { tree.eraseIf(ThrowAt()); } catch (const std::runtime_error&) { threw = true; }
+    bool ok = threw && matches(tree, expected);
+
+    // under AVL_ERASE_REBUILD_PERCENT: per-node removes
+    size_t expectedErased = eraseExpected(expected, DivisibleBy(9));
+    ok = ok && expectedErased * 100 < 300 * AVL_ERASE_REBUILD_PERCENT;
+    ok = ok && tree.eraseIf(DivisibleBy(9)) == expectedErased && matches(tree, expected);
+    ok = ok && erase_if(sums, DivisibleBy(9)) == expectedErased
+         && aggregatesMatch<AugmentedAVLTree<int, int, SumAugment<int> >, SumAugment<int> >(sums, expected, 300);
+
+    // nothing matches
+    ok = ok && tree.eraseIf(DivisibleBy(9)) == 0 && matches(tree, expected);
+
+    // over the threshold: relinked into a new tree
+    size_t n = expected.size();
+    expectedErased = eraseExpected(expected, DivisibleBy(2));
+    ok = ok && expectedErased * 100 >= n * AVL_ERASE_REBUILD_PERCENT;
+    ok = ok && erase_if(tree, DivisibleBy(2)) == expectedErased && matches(tree, expected);
+    ok = ok && sums.eraseIf(DivisibleBy(2)) == expectedErased
+         && aggregatesMatch<AugmentedAVLTree<int, int, SumAugment<int> >, SumAugment<int> >(sums, expected, 300);
+
+    // the relinked tree takes updates like any other
+    for (int key = 0; key < 300; key += 4)
+    {
+        tree.insert(make_pair(key, -key));
+        expected[key] = -key;
+    }
+    tree.remove(1);
+    expected.erase(1);
+    ok = ok && matches(tree, expected);
+
+    // everything matches
+    ok = ok && tree.eraseIf(DivisibleBy(1)) == expected.size();
+    expected.clear();
+    check(ok && matches(tree, expected) && tree.empty(), msg);
+}
+
+// Unsorted input with repeated keys keeps the last value of each key, on
+// one thread or several, and replaces whatever the tree held before. A
+// sort that throws leaves the tree as it was; a build that throws on any
+// thread frees what it built and leaves the tree empty.
+void testBulkBuild(const char* msg)
+{
+    const int n = 3 * AVL_PARALLEL_CUTOFF;
+    vector<pair<int, int> > items;
+    map<int, int> expected;
+    for (int i = 0; i < n; i++)
+    {
+        int key = (int)(((long long)i * 7919) % (n / 2));
+        items.push_back(make_pair(key, i));
+        expected[key] = i;
+    }
+
+    AVLTree<int, int> serial, parallel;
+    for (int i = 0; i < 100; i++) parallel.insert(make_pair(-i, i));
+    serial.bulkBuild(items, 1);
+    parallel.bulkBuild(items, 4);
+    bool ok = matches(serial, expected) && matches(parallel, expected);
+
+    // the rebuilt tree takes updates like any other
+    parallel.insert(make_pair(n, 0));
+    parallel.remove(0);
+    expected[n] = 0;
+    expected.erase(0);
+    ok = ok && matches(parallel, expected);
+
+    map<int, int> none;
+    parallel.bulkBuild(vector<pair<int, int> >(), 4);
+    ok = ok && matches(parallel, none);
+
+    AVLTree<int, Fragile> fragile;
+    fragile.insert(make_pair(1, Fragile(1)));
+    int caught = 0;
+    vector<pair<int, Fragile> > unsorted, sorted;
+    for (int i = 0; i < n; i++)
+    {
+        unsorted.push_back(make_pair(n - i, Fragile(i)));
+        sorted.push_back(make_pair(i, Fragile(i)));
+    }
+    Fragile::budget = 10;
+    try { fragile.bulkBuild(std::move(unsorted), 4); } catch (const std::bad_alloc&) { caught++; }
+    ok = ok && fragile.size() == 1 && fragile.isBalanced();
+    Fragile::budget = n - 10;
+    try { fragile.bulkBuild(std::move(sorted), 4); } catch (const std::bad_alloc&) { caught++; }
+    Fragile::budget = -1;
+    ok = ok && caught == 2 && fragile.empty() && fragile.begin() == fragile.end();
+    fragile.insert(make_pair(3, Fragile(3)));
+    check(ok && fragile.size() == 1 && fragile.isBalanced(), msg);
+}
+
+static bool sameRecords(const vector<TraceRecord>& read, const TraceRecord* expected, size_t count)
+{
+    if (read.size() != count) return false;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (read[i].op != expected[i].op || read[i].key != expected[i].key || read[i].arg != expected[i].arg) return false;
+    }
+    return true;
+}
+
+// reads trace and reports whether it threw; records holds what was read
+static bool readThrows(const string& trace, vector<TraceRecord>& records)
+{
+    istringstream is(trace);
+    try
+    {
+        readTrace(is, records);
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+    return false;
+}
+
+// Keys round-trip through the zigzag deltas at both ends of int64_t and
+// across the largest jumps either way. A cut-off record or an unknown op
+// throws, after the records before it are read back intact.
+void testTraceRoundTrip(const char* msg)
+{
+    const int64_t lowest = std::numeric_limits<int64_t>::min();
+    const int64_t highest = std::numeric_limits<int64_t>::max();
+    const TraceRecord written[] = {
+        { TRACE_INSERT, highest, std::numeric_limits<uint64_t>::max() },
+        { TRACE_FIND, lowest, 0 },
+        { TRACE_REMOVE, highest, 0 },
+        { TRACE_FIND, 0, 0 },
+        { TRACE_RANGE, -5, 10 },
+        { TRACE_FIND, -6, 0 },
+        { TRACE_INSERT, -70000, 127 },
+        { TRACE_REMOVE, -69999, 0 },
+        { TRACE_RANGE, lowest, std::numeric_limits<uint64_t>::max() },
+        { TRACE_INSERT, -1, 128 },
+    };
+    const size_t count = sizeof(written) / sizeof(written[0]);
+
+    ostringstream os;
+    TraceWriter writer(os);
+    for (size_t i = 0; i < count; i++) writer.record(written[i].op, written[i].key, written[i].arg);
+    string trace = os.str();
+
+    vector<TraceRecord> records;
+    bool ok = writer.records() == count && !readThrows(trace, records) && sameRecords(records, written, count);
+
+    // the last record's value 128 takes two bytes: drop one, then the value, then part of the key
+    ok = ok && readThrows(trace.substr(0, trace.size() - 1), records) && sameRecords(records, written, count - 1);
+    ok = ok && readThrows(trace.substr(0, trace.size() - 2), records) && sameRecords(records, written, count - 1);
+    ostringstream far;
+    TraceWriter farWriter(far);
+    farWriter.record(TRACE_FIND, 1);
+    farWriter.record(TRACE_FIND, highest); // a ten-byte key delta
+    string cutKey = far.str();
+    const TraceRecord farRecord[] = { { TRACE_FIND, 1, 0 } };
+    ok = ok && readThrows(cutKey.substr(0, cutKey.size() - 3), records) && sameRecords(records, farRecord, 1);
+
+    // unknown ops, before and after the known range
+    ok = ok && readThrows(trace + string(1, '\0'), records) && sameRecords(records, written, count);
+    ok = ok && readThrows(trace + string(1, (char)(TRACE_RANGE + 1)) + string(1, '\0'), records)
+         && sameRecords(records, written, count);
+
+    // a traced tree records what it is asked, including a range over every key
+    ostringstream tracedOs;
+    TraceWriter tracedWriter(tracedOs);
+    TracedTree<int64_t, int> tree;
+    tree.startTrace(&tracedWriter);
+    tree.insert(make_pair(lowest, 1));
+    tree.insert(make_pair(highest, 2));
+    int visited = 0;
+    tree.forEachInRange(lowest, highest, [&visited](const pair<const int64_t, int>&) { visited++; });
+    tree.remove(lowest);
+    tree.stopTrace();
+    tree.find(highest);
+    const TraceRecord traced[] = {
+        { TRACE_INSERT, lowest, 1 },
+        { TRACE_INSERT, highest, 2 },
+        { TRACE_RANGE, lowest, std::numeric_limits<uint64_t>::max() },
+        { TRACE_REMOVE, lowest, 0 },
+    };
+    ok = ok && visited == 2 && !readThrows(tracedOs.str(), records) && sameRecords(records, traced, 4);
+
+    check(ok, msg);
+}
+
+static off_t fileSize(const string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_size : -1;
+}
+
+static string readBytes(const string& path)
+{
+    string contents;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return contents;
+    char buffer[4096];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) contents.append(buffer, got);
+    fclose(file);
+    return contents;
+}
+
+static void writeBytes(const string& path, const string& contents)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+}
+
+// path for a fresh durable tree, with any files from earlier runs removed
+static string durablePath(const char* name)
+{
+    string path = string("/tmp/bst-test-") + name;
+    unlink((path + ".wal").c_str());
+    unlink((path + ".snap").c_str());
+    return path;
+}
+
+static DurabilityOptions everyUpdate()
+{
+    DurabilityOptions options;
+    options.groupCommitOps = 1;
+    options.checkpointBytes = 0;
+    return options;
+}
+
+// A crash in the middle of the last record leaves a torn tail: recovery
+// keeps every whole record, cuts the tail off and appends after it.
+void testWalTruncatedTail(const char* msg)
+{
+    string path = durablePath("tail");
+    {
+        DurableAVLTree<int, int> tree(path, everyUpdate());
+        for (int i = 0; i < 10; i++) tree.insert(make_pair(i, i * 10));
+    }
+    off_t whole = fileSize(path + ".wal");
+    off_t record = whole / 10;
+    if (truncate((path + ".wal").c_str(), whole - 3) != 0) perror("truncate");
+
+    map<int, int> expected;
+    for (int i = 0; i < 9; i++) expected[i] = i * 10;
+    bool recovered, appended;
+    {
+        DurableAVLTree<int, int> tree(path, everyUpdate());
+        recovered = matches(tree.tree(), expected) && fileSize(path + ".wal") == 9 * record;
+        tree.insert(make_pair(100, 1));
+        expected[100] = 1;
+    }
+    {
+        DurableAVLTree<int, int> tree(path, everyUpdate());
+        appended = matches(tree.tree(), expected);
+    }
+    check(recovered && appended, msg);
+}
+
+// A garbled record ends the log: it and everything after it is dropped.
+void testWalCorruptRecord(const char* msg)
+{
+    string path = durablePath("corrupt");
+    {
+        DurableAVLTree<int, int> tree(path, everyUpdate());
+        for (int i = 0; i < 10; i++) tree.insert(make_pair(i, i));
+    }
+    string log = readBytes(path + ".wal");
+    size_t record = log.size() / 10;
+    log[5 * record + record - 1] ^= 0x5a; // last payload byte of the sixth record
+    writeBytes(path + ".wal", log);
+
+    map<int, int> expected;
+    for (int i = 0; i < 5; i++) expected[i] = i;
+    DurableAVLTree<int, int> tree(path, everyUpdate());
+    check(matches(tree.tree(), expected), msg);
+}
+
+// A crash after the new snapshot is in place but before the log is
+// emptied replays the whole old log over the new snapshot. Updates still
+// queued when checkpoint() starts are committed first, so they are in
+// both the snapshot and that log.
+void testCrashBeforeLogTruncate(const char* msg)
+{
+    string path = durablePath("checkpoint");
+    DurabilityOptions options;
+    options.groupCommitOps = 1000;
+    options.checkpointBytes = 0;
+    map<int, int> expected;
+    string oldLog;
+    {
+        DurableAVLTree<int, int> tree(path, options);
+        for (int i = 0; i < 40; i++)
+        {
+            tree.insert(make_pair(i, i));
+            expected[i] = i;
+        }
+        tree.commit();
+        for (int i = 0; i < 10; i++)
+        {
+            tree.remove(i);
+            expected.erase(i);
+        }
+        tree.insert(make_pair(20, -20));
+        expected[20] = -20;
+        tree.remove(30);
+        expected.erase(30);
+
+        tree.checkpoint(); // commits the queued updates first
+        tree.insert(make_pair(40, 40));
+        expected[40] = 40;
+        tree.commit();
+        oldLog = readBytes(path + ".wal");
+        tree.checkpoint();
+    }
+    bool afterCheckpoint;
+    {
+        DurableAVLTree<int, int> tree(path, options);
+        afterCheckpoint = matches(tree.tree(), expected);
+    }
+    writeBytes(path + ".wal", oldLog);
+    DurableAVLTree<int, int> tree(path, options);
+    check(afterCheckpoint && matches(tree.tree(), expected), msg);
+}
+
+// A commit cut short (here by the file size limit) leaves the log as it
+// was, so the retried commit and every later one survive recovery.
+void testWalFailedCommit(const char* msg)
+{
+    string path = durablePath("short");
+    DurabilityOptions options;
+    options.groupCommitOps = 1000;
+    options.checkpointBytes = 0;
+    map<int, int> expected;
+
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit saved;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    bool threw = false, rolledBack;
+    {
+        DurableAVLTree<int, int> tree(path, options);
+        for (int i = 0; i < 5; i++)
+        {
+            tree.insert(make_pair(i, i));
+            expected[i] = i;
+        }
+        tree.commit();
+        off_t good = fileSize(path + ".wal");
+
+        for (int i = 5; i < 15; i++)
+        {
+            tree.insert(make_pair(i, i));
+            expected[i] = i;
+        }
+        struct rlimit limited = saved;
+        limited.rlim_cur = good + 20;
+        setrlimit(RLIMIT_FSIZE, &limited);
+        try
+        {
+            tree.commit();
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        setrlimit(RLIMIT_FSIZE, &saved);
+        rolledBack = fileSize(path + ".wal") == good;
+
+        tree.commit();
+        tree.insert(make_pair(99, 99));
+        expected[99] = 99;
+    }
+    signal(SIGXFSZ, SIG_DFL);
+    DurableAVLTree<int, int> tree(path, options);
+    check(threw && rolledBack && matches(tree.tree(), expected), msg);
+}
+
+// The item count is checksummed and the items must end at the checksum.
+void testSnapshotHeader(const char* msg)
+{
+    string path = durablePath("snapshot");
+    {
+        DurableAVLTree<int, int> tree(path, everyUpdate());
+        for (int i = 0; i < 10; i++) tree.insert(make_pair(i, i));
+        tree.checkpoint();
+    }
+    string snapshot = readBytes(path + ".snap");
+    bool rejected = true;
+    for (int damage = 0; damage < 2; damage++)
+    {
+        string bad = snapshot;
+        if (damage == 0) bad[8] ^= 1; // the low byte of the item count
+        else bad.insert(bad.size() - 4, "x");
+        writeBytes(path + ".snap", bad);
+        try
+        {
+            DurableAVLTree<int, int> tree(path, everyUpdate());
+            rejected = false;
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+    }
+    check(rejected, msg);
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -42,5 +1197,28 @@ int main(int argc, char *argv[])
     d.remove(5);
 
     d.print();
-    return 0;
+
+    testFilterThroughBase("filter after updates through base references");
+    testNodeKinds("node handles, merge and assignment between tree kinds");
+    testIntervalDuplicateStarts("interval tree with shared start points");
+    testExportJson("json export of numbers, bools and samples");
+    testCopyMoveSwap("copy, move and swap through base references");
+    testCopyThrows("copy that throws part way");
+    testValidateBalance("validation of an unbalanced AVL tree");
+    testEraseRanges("range erase by key and by iterator");
+    testAggregates("sum, min and max aggregates after updates");
+    testMovedAggregates("aggregates of nodes moved by handle and merge");
+    testAdaptiveThresholds("adaptive map across promote and demote");
+    testPooledUpdates("pooled tree inserts, removes and slot reuse");
+    testEraseIf("eraseIf per node and by rebuild");
+    testBulkBuild("bulk build of unsorted, repeated keys");
+    testTraceRoundTrip("trace records round-trip and reject bad input");
+    testWalTruncatedTail("wal recovery with a torn tail");
+    testWalCorruptRecord("wal recovery stops at a corrupt record");
+    testCrashBeforeLogTruncate("crash between snapshot and log truncate");
+    testWalFailedCommit("wal rollback after a short write");
+    testSnapshotHeader("snapshot with a bad count or trailing bytes");
+
+    cout << (failures == 0 ? "all tests passed" : "some tests FAILED") << endl;
+    return failures == 0 ? 0 : 1;
 }
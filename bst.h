@@ -3,8 +3,21 @@
 
 #include <iostream>
 #include <exception>
+#include <stdexcept>
+#include <typeinfo>
 #include <cstdlib>
 #include <utility>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+// trees with at least this many nodes are copied on several threads
+#define BST_PARALLEL_CLONE_CUTOFF 65536
+// number of searches prefetchPaths walks down the tree side by side
+#define BST_PREFETCH_GROUP 16
+
+// opt-in latency histograms (-DBST_LATENCY)
+#include "latency_bst.h"
 
 /**
  * A templated class for a Node in a search tree.
@@ -35,6 +48,8 @@ public:
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
 
+    virtual Node<Key, Value>* clone(Node<Key, Value>* parent) const;
+
 protected:
     std::pair<const Key, Value> item_;
     Node<Key, Value>* parent_;
@@ -180,12 +195,30 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* Returns a new, unlinked node of the same type with the same item and
+* per-node data, hung below parent.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* Node<Key, Value>::clone(Node<Key, Value>* parent) const
+{
+    return new Node<Key, Value>(item_.first, item_.second, parent);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+struct ValidationReport;
+struct MemoryUsage;
+template<typename Key> struct ExportOptions;
+template<typename Key, typename Value> struct TraversalPiece;
+template<typename Key, typename Value, typename Function> struct ForEachWorker;
+template<typename Key, typename Value, typename T, typename Map, typename Combine> struct ReduceWorker;
+template<typename Key, typename Value> struct ValidationSummary;
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -194,13 +227,27 @@ class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    BinarySearchTree(const BinarySearchTree<Key, Value>& other);
+    BinarySearchTree(BinarySearchTree<Key, Value>&& other);
     virtual ~BinarySearchTree(); //TODO
+    BinarySearchTree<Key, Value>& operator=(const BinarySearchTree<Key, Value>& other);
+    BinarySearchTree<Key, Value>& operator=(BinarySearchTree<Key, Value>&& other);
+    virtual void swap(BinarySearchTree<Key, Value>& other);
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
+    virtual void clear(); //TODO
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    size_t size() const;
+    MemoryUsage memoryUsage() const;
+    ValidationReport validate(unsigned threads = 0) const;
+    void exportDot(std::ostream& os, const ExportOptions<Key>& options = ExportOptions<Key>()) const;
+    void exportJson(std::ostream& os, const ExportOptions<Key>& options = ExportOptions<Key>()) const;
+    template<typename Function>
+    void parallelForEach(Function fn, unsigned threads = 0) const;
+    template<typename T, typename Map, typename Combine>
+    T parallelReduce(T init, Map map, Combine combine, unsigned threads = 0) const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
@@ -227,12 +274,50 @@ public:
         Node<Key, Value> *current_;
     };
 
+public:
+    /**
+    * An owning handle to a node that has been extracted from a tree.
+    * The node (and its key/value) can be inserted into another tree
+    * of the same kind without allocating or copying. A handle that
+    * still owns its node frees it when destroyed.
+    */
+    class NodeHandle
+    {
+    public:
+        NodeHandle();
+        NodeHandle(NodeHandle&& other);
+        NodeHandle& operator=(NodeHandle&& other);
+        ~NodeHandle();
+
+        bool empty() const;
+        const Key& key() const;
+        Value& value() const;
+
+    protected:
+        friend class BinarySearchTree<Key, Value>;
+        NodeHandle(Node<Key, Value>* node);
+        NodeHandle(const NodeHandle& other); // not copyable
+        NodeHandle& operator=(const NodeHandle& other);
+        Node<Key, Value>* node_;
+    };
+
 public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    iterator lowerBound(const Key& key) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
+    bool contains(const Key& key) const;
+    Value* get(const Key& key);
+    const Value* get(const Key& key) const;
+    void prefetchPaths(const Key* keys, size_t count) const;
+
+    iterator erase(iterator pos);
+    NodeHandle extract(const Key& key);
+    NodeHandle extract(iterator pos);
+    bool insert(NodeHandle&& handle);
+    void merge(BinarySearchTree<Key, Value>& other);
 
 protected:
     // Mandatory helper functions
@@ -245,15 +330,44 @@ protected:
     // Provided helper functions
     virtual void printRoot (Node<Key, Value> *r) const;
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
+    static iterator makeIterator(Node<Key, Value>* node);
+    static Node<Key, Value>* iteratorNode(const iterator& it);
+    virtual void unlinkNode(Node<Key, Value>* node);
+    virtual bool insertNode(Node<Key, Value>* node);
+    Node<Key, Value>* exportStart(const ExportOptions<Key>& options) const;
+    void cutPieces(unsigned threads, std::vector<TraversalPiece<Key, Value> >& pieces) const;
+    static void cutSubtree(Node<Key, Value>* thisNode, int levels, std::vector<TraversalPiece<Key, Value> >& pieces);
+    template<typename Function>
+    static void visitPiece(const TraversalPiece<Key, Value>& piece, Function& fn);
+    template<typename K, typename V, typename F> friend struct ForEachWorker;
+    template<typename K, typename V, typename T, typename M, typename C> friend struct ReduceWorker;
+    virtual bool checkNodeBalance(const Node<Key, Value>* thisNode, int leftHeight, int rightHeight) const;
+    virtual bool keepsBalance() const;
+    void combineValidation(const Node<Key, Value>* thisNode, const ValidationSummary<Key, Value>* left,
+                           const ValidationSummary<Key, Value>* right, ValidationSummary<Key, Value>& result) const;
+    void validateSubtree(const Node<Key, Value>* root, ValidationSummary<Key, Value>& result) const;
+    void validateParallel(const Node<Key, Value>* root, unsigned threads, int depth,
+                          ValidationSummary<Key, Value>& result) const;
+    virtual size_t nodeBytes() const;
+    virtual const std::type_info& nodeType() const;
+    void checkSameKind(const BinarySearchTree<Key, Value>& other) const;
+    virtual void afterStructureChange();
 
     // Add helper functions here
-    void clearHelp(Node<Key, Value>* currentNode);
+    static size_t clearHelp(Node<Key, Value>* currentNode);
+    void copyFrom(const BinarySearchTree<Key, Value>& other);
+    static Node<Key, Value>* cloneSubtree(const Node<Key, Value>* source, Node<Key, Value>* parent);
+    static void cloneParallel(const Node<Key, Value>* source, Node<Key, Value>* parent, unsigned threads,
+                              Node<Key, Value>** result);
+    static void cloneWorker(const Node<Key, Value>* source, Node<Key, Value>* parent, unsigned threads,
+                            Node<Key, Value>** result, std::exception_ptr* error);
     int getHeight(const Node<Key, Value>* root) const;
     static Node<Key, Value>* successor(Node<Key, Value>* current);
 
 
 protected:
     Node<Key, Value>* root_;
+    size_t size_; // number of nodes, kept by every insert/unlink path
     // You should not need other data members
 };
 
@@ -349,6 +463,88 @@ End implementations for the BinarySearchTree::iterator class.
 -------------------------------------------------------------
 */
 
+/*
+-----------------------------------------------------------------
+Begin implementations for the BinarySearchTree::NodeHandle class.
+-----------------------------------------------------------------
+*/
+
+/**
+* An empty handle.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::NodeHandle::NodeHandle() :
+    node_(nullptr)
+{
+
+}
+
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::NodeHandle::NodeHandle(Node<Key, Value>* node) :
+    node_(node)
+{
+
+}
+
+/**
+* Takes over the node owned by other, leaving other empty.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::NodeHandle::NodeHandle(NodeHandle&& other) :
+    node_(other.node_)
+{
+    other.node_ = nullptr;
+}
+
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::NodeHandle&
+BinarySearchTree<Key, Value>::NodeHandle::operator=(NodeHandle&& other)
+{
+    if (this != &other)
+    {
+        delete node_;
+        node_ = other.node_;
+        other.node_ = nullptr;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::NodeHandle::~NodeHandle()
+{
+    delete node_;
+}
+
+template<class Key, class Value>
+bool BinarySearchTree<Key, Value>::NodeHandle::empty() const
+{
+    return node_ == nullptr;
+}
+
+/**
+ * @precondition The handle is not empty
+ */
+template<class Key, class Value>
+const Key& BinarySearchTree<Key, Value>::NodeHandle::key() const
+{
+    return node_->getKey();
+}
+
+/**
+ * @precondition The handle is not empty
+ */
+template<class Key, class Value>
+Value& BinarySearchTree<Key, Value>::NodeHandle::value() const
+{
+    return node_->getValue();
+}
+
+/*
+---------------------------------------------------------------
+End implementations for the BinarySearchTree::NodeHandle class.
+---------------------------------------------------------------
+*/
+
 /*
 -----------------------------------------------------
 Begin implementations for the BinarySearchTree class.
@@ -362,6 +558,32 @@ template<class Key, class Value>
 BinarySearchTree<Key, Value>::BinarySearchTree() 
 {
     root_ = nullptr;
+    size_ = 0;
+}
+
+/**
+* Copies other node for node, keeping its exact shape (and any per-node
+* data such as balance factors) instead of re-inserting, in O(n).
+* Large trees are copied on several threads.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(const BinarySearchTree<Key, Value>& other)
+{
+    root_ = nullptr;
+    size_ = 0;
+    copyFrom(other);
+}
+
+/**
+* Takes over the nodes of other in O(1), leaving other empty.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(BinarySearchTree<Key, Value>&& other)
+{
+    root_ = other.root_;
+    size_ = other.size_;
+    other.root_ = nullptr;
+    other.size_ = 0;
 }
 
 template<typename Key, typename Value>
@@ -370,6 +592,47 @@ BinarySearchTree<Key, Value>::~BinarySearchTree()
     clear();
 }
 
+template<class Key, class Value>
+BinarySearchTree<Key, Value>& BinarySearchTree<Key, Value>::operator=(const BinarySearchTree<Key, Value>& other)
+{
+    if (this == &other) return *this;
+    checkSameKind(other);
+    clear();
+    copyFrom(other);
+    afterStructureChange();
+    return *this;
+}
+
+template<class Key, class Value>
+BinarySearchTree<Key, Value>& BinarySearchTree<Key, Value>::operator=(BinarySearchTree<Key, Value>&& other)
+{
+    if (this == &other) return *this;
+    checkSameKind(other);
+    clear();
+    root_ = other.root_;
+    size_ = other.size_;
+    other.root_ = nullptr;
+    other.size_ = 0;
+    afterStructureChange();
+    other.afterStructureChange();
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees of the same kind. The nodes change
+* hands in O(1); anything a tree derives from its nodes is refreshed
+* through afterStructureChange(), unless the tree swaps it directly.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::swap(BinarySearchTree<Key, Value>& other)
+{
+    checkSameKind(other);
+    std::swap(root_, other.root_);
+    std::swap(size_, other.size_);
+    afterStructureChange();
+    other.afterStructureChange();
+}
+
 /**
  * Returns true if tree is empty
 */
@@ -379,6 +642,15 @@ bool BinarySearchTree<Key, Value>::empty() const
     return root_ == NULL;
 }
 
+/**
+ * Returns the number of items in the tree in O(1)
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::size() const
+{
+    return size_;
+}
+
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::print() const
 {
@@ -416,11 +688,34 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::find(const Key & k) const
 {
+    BST_LATENCY_SCOPE(LATENCY_FIND, size_);
     Node<Key, Value> *curr = internalFind(k);
     BinarySearchTree<Key, Value>::iterator it(curr);
     return it;
 }
 
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or the end iterator if there is none.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::lowerBound(const Key& key) const
+{
+    Node<Key, Value>* currentNode = root_;
+    Node<Key, Value>* bound = nullptr;
+    while (currentNode != nullptr)
+    {
+        if (currentNode->getKey() < key) currentNode = currentNode->getRight();
+        else
+        {
+            bound = currentNode;
+            currentNode = currentNode->getLeft();
+        }
+    }
+    return makeIterator(bound);
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
@@ -440,6 +735,69 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
     return curr->getValue();
 }
 
+/**
+ * Returns true if the key is in the tree
+ */
+template<class Key, class Value>
+bool BinarySearchTree<Key, Value>::contains(const Key& key) const
+{
+    return internalFind(key) != NULL;
+}
+
+/**
+ * Returns a pointer to the value for key, or NULL if the key is not in
+ * the tree. Unlike operator[], a miss does not throw.
+ */
+template<class Key, class Value>
+Value* BinarySearchTree<Key, Value>::get(const Key& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    return curr == NULL ? NULL : &curr->getValue();
+}
+
+template<class Key, class Value>
+const Value* BinarySearchTree<Key, Value>::get(const Key& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    return curr == NULL ? NULL : &curr->getValue();
+}
+
+/**
+ * Walks the search paths of several keys down the tree side by side,
+ * BST_PREFETCH_GROUP at a time, prefetching each next node. A single
+ * search waits on one cache miss per level; interleaving independent
+ * searches overlaps those misses, so a batch of inserts or finds that
+ * follows runs mostly out of cache. Changes nothing.
+ */
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::prefetchPaths(const Key* keys, size_t count) const
+{
+    Node<Key, Value>* paths[BST_PREFETCH_GROUP];
+    for (size_t first = 0; first < count; first += BST_PREFETCH_GROUP)
+    {
+        size_t group = std::min(count - first, (size_t)BST_PREFETCH_GROUP);
+        for (size_t i = 0; i < group; i++) paths[i] = root_;
+
+        bool walking = true;
+        while (walking)
+        {
+            walking = false;
+            for (size_t i = 0; i < group; i++)
+            {
+                if (paths[i] == nullptr) continue;
+                const Key& key = keys[first + i];
+                if (key == paths[i]->getKey()) paths[i] = nullptr;
+                else paths[i] = key < paths[i]->getKey() ? paths[i]->getLeft() : paths[i]->getRight();
+                if (paths[i] != nullptr)
+                {
+                    __builtin_prefetch(paths[i]);
+                    walking = true;
+                }
+            }
+        }
+    }
+}
+
 /**
 * An insert method to insert into a Binary Search Tree.
 * The tree will not remain balanced when inserting.
@@ -449,9 +807,11 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 template<class Key, class Value>
 void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
+    BST_LATENCY_SCOPE(LATENCY_INSERT, size_);
     if (root_ == nullptr) // If the tree is empty
     {
         root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
+        size_++;
         return;
     }
     
@@ -481,6 +841,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
     
     // Creating the new node
     Node<Key, Value>* newNode = new Node<Key,Value>(keyValuePair.first, keyValuePair.second, currentNode);
+    size_++;
     
     // updating the parent nodes left/right
     if (keyValuePair.first < currentNode->getKey())
@@ -502,16 +863,27 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::remove(const Key& key)
 {
+    BST_LATENCY_SCOPE(LATENCY_REMOVE, size_);
     Node<Key, Value>* nodeToRemove = internalFind(key);
     
     if (nodeToRemove == nullptr) return;
+    unlinkNode(nodeToRemove);
+    delete nodeToRemove;
+}
+
+/**
+* Detaches a node from the tree without freeing it, using the same
+* predecessor swap as remove(). The node's own links are left stale.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::unlinkNode(Node<Key, Value>* nodeToRemove)
+{
+    size_--;
     if (nodeToRemove == root_ && nodeToRemove->getLeft() == nullptr && nodeToRemove->getRight() == nullptr)
     {
-        delete nodeToRemove;
         root_ = nullptr;
         return;
     }
-
     if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() != nullptr)
     {
         nodeSwap(nodeToRemove, predecessor(nodeToRemove));
@@ -569,11 +941,139 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
             parent->setRight(nullptr);
         }
     }
+}
 
+/**
+* Links a detached node into the tree. Returns false (and leaves the
+* node untouched) if its key is already present.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::insertNode(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = nullptr;
+    Node<Key, Value>* currentNode = root_;
+    while (currentNode != nullptr)
+    {
+        if (currentNode->getKey() == node->getKey()) return false;
+        parent = currentNode;
+        if (node->getKey() < currentNode->getKey()) currentNode = currentNode->getLeft();
+        else currentNode = currentNode->getRight();
+    }
+
+    node->setParent(parent);
+    node->setLeft(nullptr);
+    node->setRight(nullptr);
+    size_++;
+    if (parent == nullptr) root_ = node;
+    else if (node->getKey() < parent->getKey()) parent->setLeft(node);
+    else parent->setRight(node);
+    return true;
+}
+
+/**
+* Removes the item at pos and returns an iterator to the item after it.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::erase(iterator pos)
+{
+    Node<Key, Value>* nodeToRemove = pos.current_;
+    if (nodeToRemove == nullptr) return end();
+
+    // node objects are relinked, never moved, so the successor stays valid
+    Node<Key, Value>* next = successor(nodeToRemove);
+    unlinkNode(nodeToRemove);
     delete nodeToRemove;
+    return iterator(next);
+}
+
+/**
+* Detaches the node with the given key and hands ownership to the caller.
+* Returns an empty handle if the key is not in the tree.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::NodeHandle
+BinarySearchTree<Key, Value>::extract(const Key& key)
+{
+    return extract(find(key));
+}
+
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::NodeHandle
+BinarySearchTree<Key, Value>::extract(iterator pos)
+{
+    Node<Key, Value>* node = pos.current_;
+    if (node == nullptr) return NodeHandle();
+
+    unlinkNode(node);
+    node->setParent(nullptr);
+    node->setLeft(nullptr);
+    node->setRight(nullptr);
+    return NodeHandle(node);
 }
 
+/**
+* Links the node owned by handle into the tree. The handle must come
+* from a tree with the same node type (e.g. AVLTree handles into an
+* AVLTree); otherwise std::invalid_argument is thrown and the handle
+* keeps its node. Returns false and leaves the handle owning the node if
+* the key is already present or the handle is empty.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::insert(NodeHandle&& handle)
+{
+    if (handle.node_ == nullptr) return false;
+    if (typeid(*handle.node_) != nodeType()) throw std::invalid_argument("node handle from a different kind of tree");
+    if (!insertNode(handle.node_)) return false;
+    handle.node_ = nullptr;
+    return true;
+}
+
+/**
+* Moves every node of other whose key is not already in this tree over,
+* relinking the nodes instead of copying them. Nodes with duplicate keys
+* stay in other. Both trees must use the same node type, or
+* std::invalid_argument is thrown and neither tree changes.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::merge(BinarySearchTree<Key, Value>& other)
+{
+    if (&other == this) return;
+    checkSameKind(other);
 
+    Node<Key, Value>* currentNode = other.getSmallestNode();
+    while (currentNode != nullptr)
+    {
+        Node<Key, Value>* next = successor(currentNode);
+        if (internalFind(currentNode->getKey()) == nullptr)
+        {
+            other.unlinkNode(currentNode);
+            insertNode(currentNode);
+        }
+        currentNode = next;
+    }
+}
+
+/**
+* Type of the nodes the tree allocates. Trees that allocate a node type
+* of their own override it, so nodes are only ever moved between trees
+* that link them the same way.
+*/
+template<typename Key, typename Value>
+const std::type_info& BinarySearchTree<Key, Value>::nodeType() const
+{
+    return typeid(Node<Key, Value>);
+}
+
+/*
+ * Merging, swapping or assigning hands the nodes of one tree to the
+ * other, which then casts them to its own node type.
+ */
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::checkSameKind(const BinarySearchTree<Key, Value>& other) const
+{
+    if (other.nodeType() != nodeType()) throw std::invalid_argument("trees of different kinds");
+}
 
 template<class Key, class Value>
 Node<Key, Value>*
@@ -622,25 +1122,42 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::successor(Node<Key, Value>* curr
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::clear()
 {
+    BST_LATENCY_SCOPE(LATENCY_CLEAR, size_);
     clearHelp(root_);
     //if (root_ != nullptr) delete root_;
     root_ = nullptr;
+    size_ = 0;
+}
+
+/*
+ * Called after the nodes were replaced wholesale (assignment, bulk
+ * builds, rebuilds), so subclasses can refresh anything they derive
+ * from them.
+ */
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::afterStructureChange()
+{
+
 }
 
 
+/**
+* Frees the subtree at currentNode and returns how many nodes it held.
+*/
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clearHelp(Node<Key, Value>* currentNode)
+size_t BinarySearchTree<Key, Value>::clearHelp(Node<Key, Value>* currentNode)
 {
 
-    if (currentNode == nullptr) return;
+    if (currentNode == nullptr) return 0;
+    size_t freed = 1;
     if (currentNode->getLeft() != nullptr) 
     {
-        clearHelp(currentNode->getLeft());
+        freed += clearHelp(currentNode->getLeft());
         currentNode->setLeft(nullptr);
     }
     if (currentNode->getRight() != nullptr) 
     {
-        clearHelp(currentNode->getRight());
+        freed += clearHelp(currentNode->getRight());
         currentNode->setRight(nullptr);
     }
 
@@ -649,9 +1166,150 @@ void BinarySearchTree<Key, Value>::clearHelp(Node<Key, Value>* currentNode)
         delete currentNode;
         currentNode = nullptr;
     }
+    return freed;
 }
 
 
+/**
+* Replaces the (empty) contents of this tree with a copy of other.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::copyFrom(const BinarySearchTree<Key, Value>& other)
+{
+    if (other.root_ == nullptr) return;
+
+    unsigned threads = 1;
+    if (other.size_ >= BST_PARALLEL_CLONE_CUTOFF) threads = std::max(1u, std::thread::hardware_concurrency());
+    cloneParallel(other.root_, nullptr, threads, &root_);
+    size_ = other.size_;
+}
+
+/**
+* Copies the subtree at source without recursion, so degenerate trees
+* cannot overflow the stack. Returns the copy of source. If copying a
+* node throws, the partial copy is freed and the exception passed on.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cloneSubtree(const Node<Key, Value>* source, Node<Key, Value>* parent)
+{
+    Node<Key, Value>* copy = source->clone(parent);
+
+    try
+    {
+        // nodes whose children still have to be copied, with their copies
+        std::vector<std::pair<const Node<Key, Value>*, Node<Key, Value>*> > pending;
+        pending.push_back(std::make_pair(source, copy));
+        while (!pending.empty())
+        {
+            const Node<Key, Value>* sourceNode = pending.back().first;
+            Node<Key, Value>* copyNode = pending.back().second;
+            pending.pop_back();
+
+            if (sourceNode->getLeft() != nullptr)
+            {
+                Node<Key, Value>* left = sourceNode->getLeft()->clone(copyNode);
+                copyNode->setLeft(left);
+                pending.push_back(std::make_pair(sourceNode->getLeft(), left));
+            }
+            if (sourceNode->getRight() != nullptr)
+            {
+                Node<Key, Value>* right = sourceNode->getRight()->clone(copyNode);
+                copyNode->setRight(right);
+                pending.push_back(std::make_pair(sourceNode->getRight(), right));
+            }
+        }
+    }
+    catch (...)
+    {
+        clearHelp(copy);
+        throw;
+    }
+    return copy;
+}
+
+/**
+* Copies the subtree at source into *result, handing the right subtree to
+* another thread while threads remain. An exception on either side (such
+* as std::bad_alloc) frees the partial copy and is rethrown here, on the
+* calling thread; if no thread can be started, the right side is copied
+* here as well.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::cloneParallel(const Node<Key, Value>* source, Node<Key, Value>* parent,
+                                                 unsigned threads, Node<Key, Value>** result)
+{
+    if (threads <= 1 || source->getLeft() == nullptr || source->getRight() == nullptr)
+    {
+        *result = cloneSubtree(source, parent);
+        return;
+    }
+
+    Node<Key, Value>* copy = source->clone(parent);
+    Node<Key, Value>* left = nullptr;
+    Node<Key, Value>* right = nullptr;
+    std::exception_ptr leftError, rightError;
+    unsigned rightThreads = threads / 2;
+    std::thread worker;
+    try
+    {
+        worker = std::thread(&BinarySearchTree<Key, Value>::cloneWorker, source->getRight(), copy, rightThreads,
+                             &right, &rightError);
+    }
+    catch (...)
+    {
+        cloneWorker(source->getRight(), copy, 1, &right, &rightError);
+    }
+    cloneWorker(source->getLeft(), copy, threads - rightThreads, &left, &leftError);
+    if (worker.joinable()) worker.join();
+
+    copy->setLeft(left);
+    copy->setRight(right);
+    if (leftError || rightError)
+    {
+        clearHelp(copy);
+        std::rethrow_exception(leftError ? leftError : rightError);
+    }
+    *result = copy;
+}
+
+/*
+ * cloneParallel, with any exception stored in *error instead of escaping
+ * the thread (which would terminate the program).
+ */
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::cloneWorker(const Node<Key, Value>* source, Node<Key, Value>* parent,
+                                               unsigned threads, Node<Key, Value>** result, std::exception_ptr* error)
+{
+    try
+    {
+        cloneParallel(source, parent, threads, result);
+    }
+    catch (...)
+    {
+        *error = std::current_exception();
+    }
+}
+
+/**
+* Wraps a node in an iterator. Lets derived trees hand out iterators
+* without befriending the iterator class.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::makeIterator(Node<Key, Value>* node)
+{
+    return iterator(node);
+}
+
+/**
+* Returns the node an iterator points at (NULL for end()).
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::iteratorNode(const iterator& it)
+{
+    return it.current_;
+}
+
 /**
 * A helper function to find the smallest node in the tree.
 */
@@ -821,6 +1479,18 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
 // include print function (in its own file because it's fairly long)
 #include "print_bst.h"
 
+// include structural validation (also in its own file)
+#include "validate_bst.h"
+
+// include DOT/JSON export for trees too large for printRoot()
+#include "export_bst.h"
+
+// include parallel for-each / reduce
+#include "parallel_bst.h"
+
+// include memory accounting
+#include "memory_bst.h"
+
 /*
 ---------------------------------------------------
 End implementations for the BinarySearchTree class.
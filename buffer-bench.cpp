@@ -0,0 +1,82 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "bst.h"
+#include "avlbst.h"
+#include "bufferedbst.h"
+
+using namespace std;
+
+// Sustained random writes (90% inserts, 10% removes) into a large tree,
+// straight into an AVLTree and through BufferedAVLTree write buffers of a
+// few sizes, then the cost of lookups that have to check the buffer.
+//   usage: ./buffer-bench [initialItems] [numWrites]
+
+typedef vector<pair<uint64_t, uint64_t> > Items;
+
+static double millisSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    size_t initialItems = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t numWrites = argc > 2 ? atol(argv[2]) : 2000000;
+    uint64_t keySpace = initialItems * 4;
+
+    mt19937_64 rng(108);
+    Items initial(initialItems);
+    for (size_t i = 0; i < initialItems; i++) initial[i] = make_pair(rng() % keySpace, (uint64_t)i);
+    vector<uint64_t> writes(numWrites);
+    for (size_t i = 0; i < numWrites; i++) writes[i] = rng() % keySpace;
+
+    cout << "initial=" << initialItems << " writes=" << numWrites << endl;
+
+    AVLTree<uint64_t, uint64_t> plain;
+    plain.bulkBuild(initial);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numWrites; i++)
+    {
+        if (i % 10 == 9) plain.remove(writes[i]);
+        else plain.insert(make_pair(writes[i], (uint64_t)i));
+    }
+    double writeMs = millisSince(start);
+    size_t plainHits = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < numWrites; i++) plainHits += plain.contains(writes[i]);
+    cout << "AVLTree                : " << writeMs << " ms, lookups " << millisSince(start) << " ms"
+         << (plainHits == 0 ? " (no hits)" : "") << endl;
+
+    size_t capacities[] = { 64, 256, 1024 };
+    for (size_t c = 0; c < 3; c++)
+    {
+        BufferedAVLTree<uint64_t, uint64_t> buffered(capacities[c]);
+        for (size_t i = 0; i < initialItems; i++) buffered.insert(initial[i]);
+        buffered.flush();
+
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < numWrites; i++)
+        {
+            if (i % 10 == 9) buffered.remove(writes[i]);
+            else buffered.insert(make_pair(writes[i], (uint64_t)i));
+        }
+        buffered.flush();
+        writeMs = millisSince(start);
+        bool sameSize = buffered.mergedSize() == plain.size();
+
+        // leave the buffer half full for the lookups
+        for (size_t i = 0; i < capacities[c] / 2; i++) buffered.insert(make_pair(rng() % keySpace, (uint64_t)i));
+        size_t hits = 0;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < numWrites; i++) hits += buffered.contains(writes[i]);
+        double readMs = millisSince(start);
+
+        cout << "buffer=" << capacities[c] << (capacities[c] < 1000 ? " " : "") << (capacities[c] < 100 ? " " : "")
+             << "            : " << writeMs << " ms, lookups " << readMs << " ms"
+             << (sameSize ? "" : " (size mismatch!)") << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+#ifndef BUFFEREDBST_H
+#define BUFFEREDBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "avlbst.h"
+
+// rebuild the whole tree instead of inserting one by one when the buffer
+// holds at least 1/BUFFER_REBUILD_RATIO as many items as the tree
+#define BUFFER_REBUILD_RATIO 8
+
+/**
+* An update waiting in a BufferedAVLTree's write buffer.
+*/
+template <typename Key, typename Value>
+struct BufferedUpdate
+{
+    Key key;
+    Value value;
+    bool removed; // tombstone: the key is removed
+};
+
+/**
+* An AVLTree with a log-structured write buffer in front of it. Inserts
+* and removes (as tombstones) are appended to a small unsorted buffer in
+* O(1), with no rebalancing; lookups check the buffer, newest first,
+* before the tree. When the buffer fills up it is sorted and merged into
+* the tree in one go: by inserts whose search paths are prefetched a group
+* at a time, or by rebuilding the tree with bulkBuild when the buffer is
+* large compared to the tree.
+*
+* Reads cost up to one scan of the buffer extra, so keep it small. The
+* item count and the tree are only known once the buffer is merged, so
+* mergedSize() and mergedTree() flush first.
+*/
+template <class Key, class Value>
+class BufferedAVLTree
+{
+public:
+    BufferedAVLTree(size_t bufferCapacity = 256);
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    void remove(const Key& key);
+    void flush();
+
+    bool contains(const Key& key) const;
+    const Value* get(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+    size_t mergedSize();
+    size_t bufferedUpdates() const;
+    const AVLTree<Key, Value>& mergedTree();
+
+protected:
+    void append(const Key& key, const Value& value, bool removed);
+    const BufferedUpdate<Key, Value>* findBuffered(const Key& key) const;
+    void mergeByInsert();
+    void mergeByRebuild();
+
+    static bool updateLess(const BufferedUpdate<Key, Value>& lhs, const BufferedUpdate<Key, Value>& rhs);
+
+protected:
+    AVLTree<Key, Value> tree_;
+    std::vector<BufferedUpdate<Key, Value> > buffer_;
+    size_t bufferCapacity_;
+};
+
+template<class Key, class Value>
+BufferedAVLTree<Key, Value>::BufferedAVLTree(size_t bufferCapacity) :
+    bufferCapacity_(bufferCapacity == 0 ? 1 : bufferCapacity)
+{
+    buffer_.reserve(bufferCapacity_);
+}
+
+template<class Key, class Value>
+void BufferedAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    append(new_item.first, new_item.second, false);
+}
+
+template<class Key, class Value>
+void BufferedAVLTree<Key, Value>::remove(const Key& key)
+{
+    append(key, Value(), true);
+}
+
+template<class Key, class Value>
+void BufferedAVLTree<Key, Value>::append(const Key& key, const Value& value, bool removed)
+{
+    BufferedUpdate<Key, Value> update = { key, value, removed };
+    buffer_.push_back(update);
+    if (buffer_.size() >= bufferCapacity_) flush();
+}
+
+/**
+* Merges every buffered update into the tree.
+*/
+template<class Key, class Value>
+void BufferedAVLTree<Key, Value>::flush()
+{
+    if (buffer_.empty()) return;
+
+    // the sort is stable, so the last update of each run of equal keys is the newest
+    std::stable_sort(buffer_.begin(), buffer_.end(), updateLess);
+    size_t kept = 0;
+    for (size_t i = 0; i < buffer_.size(); i++)
+    {
+        if (i + 1 < buffer_.size() && !updateLess(buffer_[i], buffer_[i + 1])) continue;
+        if (kept != i) buffer_[kept] = buffer_[i];
+        kept++;
+    }
+    buffer_.resize(kept);
+
+    if (buffer_.size() * BUFFER_REBUILD_RATIO >= tree_.size()) mergeByRebuild();
+    else mergeByInsert();
+    buffer_.clear();
+}
+
+/*
+ * Applies the sorted updates one by one, a group at a time. The search
+ * paths of each group are prefetched first, which is where the merge
+ * beats inserting the same keys unbuffered: a lone insert stalls on a
+ * cache miss at every level, a prefetched group overlaps them.
+ */
+template<class Key, class Value>
+void BufferedAVLTree<Key, Value>::mergeByInsert()
+{
+    std::vector<Key> keys;
+    keys.reserve(BST_PREFETCH_GROUP);
+    for (size_t first = 0; first < buffer_.size(); first += BST_PREFETCH_GROUP)
+    {
+        size_t last = std::min(buffer_.size(), first + BST_PREFETCH_GROUP);
+        keys.clear();
+        for (size_t i = first; i < last; i++) keys.push_back(buffer_[i].key);
+        tree_.prefetchPaths(keys.data(), keys.size());
+
+        for (size_t i = first; i < last; i++)
+        {
+            if (buffer_[i].removed) tree_.remove(buffer_[i].key);
+            else tree_.insert(std::make_pair(buffer_[i].key, buffer_[i].value));
+        }
+    }
+}
+
+/*
+ * Merges the tree's items and the sorted updates into one sorted list and
+ * builds a new tree from it, in O(n + updates). Small trees are built on
+ * the calling thread; starting threads would cost more than the build.
+ */
+template<class Key, class Value>
+void BufferedAVLTree<Key, Value>::mergeByRebuild()
+{
+    std::vector<std::pair<Key, Value> > items;
+    items.reserve(tree_.size() + buffer_.size());
+
+    typename AVLTree<Key, Value>::iterator it = tree_.begin();
+    size_t i = 0;
+    while (it != tree_.end() || i < buffer_.size())
+    {
+        if (i == buffer_.size() || (it != tree_.end() && it->first < buffer_[i].key))
+        {
+            items.push_back(std::make_pair(it->first, it->second));
+            ++it;
+            continue;
+        }
+        if (it != tree_.end() && !(buffer_[i].key < it->first)) ++it; // replaced by the update
+        if (!buffer_[i].removed) items.push_back(std::make_pair(buffer_[i].key, buffer_[i].value));
+        i++;
+    }
+    unsigned threads = items.size() < AVL_PARALLEL_CUTOFF ? 1 : 0;
+    tree_.bulkBuild(std::move(items), threads);
+}
+
+/*
+ * Returns the newest buffered update for key, or NULL.
+ */
+template<class Key, class Value>
+const BufferedUpdate<Key, Value>* BufferedAVLTree<Key, Value>::findBuffered(const Key& key) const
+{
+    for (size_t i = buffer_.size(); i > 0; i--)
+    {
+        const Key& buffered = buffer_[i - 1].key;
+        if (!(buffered < key) && !(key < buffered)) return &buffer_[i - 1];
+    }
+    return nullptr;
+}
+
+template<class Key, class Value>
+bool BufferedAVLTree<Key, Value>::contains(const Key& key) const
+{
+    return get(key) != nullptr;
+}
+
+/**
+* Returns the value for key, or NULL if it is not present. The pointer is
+* only valid until the next update.
+*/
+template<class Key, class Value>
+const Value* BufferedAVLTree<Key, Value>::get(const Key& key) const
+{
+    const BufferedUpdate<Key, Value>* update = findBuffered(key);
+    if (update != nullptr) return update->removed ? nullptr : &update->value;
+    return tree_.get(key);
+}
+
+template<class Key, class Value>
+Value const & BufferedAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    const Value* value = get(key);
+    if (value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+/**
+* Number of items. Merges the buffer first, since a buffered update may
+* or may not change the count.
+*/
+template<class Key, class Value>
+size_t BufferedAVLTree<Key, Value>::mergedSize()
+{
+    flush();
+    return tree_.size();
+}
+
+template<class Key, class Value>
+size_t BufferedAVLTree<Key, Value>::bufferedUpdates() const
+{
+    return buffer_.size();
+}
+
+/**
+* The underlying tree with every update merged in, for iteration and
+* other read-only use.
+*/
+template<class Key, class Value>
+const AVLTree<Key, Value>& BufferedAVLTree<Key, Value>::mergedTree()
+{
+    flush();
+    return tree_;
+}
+
+template<class Key, class Value>
+bool BufferedAVLTree<Key, Value>::updateLess(const BufferedUpdate<Key, Value>& lhs, const BufferedUpdate<Key, Value>& rhs)
+{
+    return lhs.key < rhs.key;
+}
+
+#endif
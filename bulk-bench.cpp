@@ -0,0 +1,65 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Builds an AVLTree from unsorted items (with some duplicate keys) by
+// repeated insert and by bulkBuild on one thread and on every thread.
+//   usage: ./bulk-bench [numItems]
+
+typedef vector<pair<uint64_t, uint64_t> > Items;
+
+template<typename Build>
+double timeBuild(Build build)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    build();
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(stop - start).count();
+}
+
+struct InsertAll
+{
+    const Items* items;
+    void operator()() const
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        for (size_t i = 0; i < items->size(); i++) tree.insert((*items)[i]);
+    }
+};
+
+struct BulkBuild
+{
+    const Items* items;
+    unsigned threads;
+    void operator()() const
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        tree.bulkBuild(*items, threads);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    size_t numItems = argc > 1 ? atol(argv[1]) : 2000000;
+    mt19937_64 rng(104);
+    Items items(numItems);
+    for (size_t i = 0; i < numItems; i++) items[i] = make_pair(rng() % (numItems * 4 / 5), i);
+
+    unsigned hardwareThreads = max(1u, thread::hardware_concurrency());
+    InsertAll insertAll = { &items };
+    BulkBuild bulkOne = { &items, 1 };
+    BulkBuild bulkAll = { &items, hardwareThreads };
+
+    cout << "items=" << numItems << endl;
+    cout << "insert one by one     : " << timeBuild(insertAll) << " ms" << endl;
+    cout << "bulkBuild, 1 thread   : " << timeBuild(bulkOne) << " ms" << endl;
+    cout << "bulkBuild, " << hardwareThreads << " threads  : " << timeBuild(bulkAll) << " ms" << endl;
+    return 0;
+}
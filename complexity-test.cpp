@@ -0,0 +1,486 @@
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Complexity regression suite: measures the cost per operation of every
+// public BinarySearchTree/AVLTree operation over a range of tree sizes,
+// works out which complexity class the curve fits best, and fails if that
+// is not the expected class. Run through "make complexity".
+//   usage: ./complexity-test [filter]   (only checks whose name contains filter)
+//
+// Each class f(n) is fitted to the curve by least squares on cost / f(n)
+// in log space, and the class with the smallest spread wins, so a curve
+// cannot fit two neighbouring classes at once.
+//
+// Operations that search by key are judged by the number of key
+// comparisons they make, counted by the key type. Their running time
+// cannot tell O(log n) from O(1) or O(log^2 n) reliably: a search through
+// a small tree costs little more than the call, and in a large one every
+// extra level can be a cache miss. The count is exact and repeatable.
+// Operations that only walk the tree (iteration, clear, copy and the
+// bulk erases) make no comparisons and are judged by their time, over
+// trees laid out in walk order and small enough for the L2 cache.
+
+// smallest and largest timed tree, as powers of two
+#define COMPLEXITY_TIMED_MIN_LOG 4
+#define COMPLEXITY_TIMED_MAX_LOG 12
+// operations per sample; small trees repeat the batch to get there
+#define COMPLEXITY_MIN_OPS (1 << 16)
+// timing repeats per size; the fastest is kept
+#define COMPLEXITY_TRIALS 7
+
+enum Complexity { CONSTANT, LOGARITHMIC, LOG_SQUARED, SQUARE_ROOT, LINEAR, LINEARITHMIC, QUADRATIC, NUM_COMPLEXITIES };
+
+static const char* complexityNames[] = { "O(1)", "O(log n)", "O(log^2 n)", "O(sqrt n)", "O(n)", "O(n log n)", "O(n^2)" };
+
+static double complexityOf(Complexity complexity, double n)
+{
+    switch (complexity)
+    {
+    case CONSTANT: return 1;
+    case LOGARITHMIC: return log2(n);
+    case LOG_SQUARED: return log2(n) * log2(n);
+    case SQUARE_ROOT: return sqrt(n);
+    case LINEAR: return n;
+    case LINEARITHMIC: return n * log2(n);
+    default: return n * n;
+    }
+}
+
+// A key that counts every comparison made on it.
+struct CountedKey
+{
+    CountedKey(uint64_t v = 0) : value(v) { }
+    uint64_t value;
+    static uint64_t comparisons;
+};
+
+uint64_t CountedKey::comparisons = 0;
+
+inline bool operator<(const CountedKey& lhs, const CountedKey& rhs)
+{
+    CountedKey::comparisons++;
+    return lhs.value < rhs.value;
+}
+
+inline bool operator==(const CountedKey& lhs, const CountedKey& rhs)
+{
+    CountedKey::comparisons++;
+    return lhs.value == rhs.value;
+}
+
+inline ostream& operator<<(ostream& os, const CountedKey& key)
+{
+    return os << key.value;
+}
+
+typedef BinarySearchTree<CountedKey, uint64_t> BST;
+typedef AVLTree<CountedKey, uint64_t> AVL;
+typedef chrono::steady_clock Clock;
+
+// The cost of one operation, averaged over a sample.
+struct Cost
+{
+    double nanos;
+    double comparisons;
+};
+
+// Adds up the time and comparisons of the timed parts of a sample.
+class Meter
+{
+public:
+    Meter() : nanos_(0), comparisons_(0), ops_(0), startComparisons_(0) { }
+
+    void start()
+    {
+        startComparisons_ = CountedKey::comparisons;
+        start_ = Clock::now();
+    }
+
+    void stop(size_t ops)
+    {
+        nanos_ += chrono::duration<double, nano>(Clock::now() - start_).count();
+        comparisons_ += CountedKey::comparisons - startComparisons_;
+        ops_ += ops;
+    }
+
+    Cost perOp() const
+    {
+        Cost cost = { nanos_ / ops_, (double)comparisons_ / ops_ };
+        return cost;
+    }
+
+private:
+    double nanos_;
+    uint64_t comparisons_;
+    size_t ops_;
+    uint64_t startComparisons_;
+    Clock::time_point start_;
+};
+
+// A measurement returns the cost per operation for a tree of n items.
+typedef function<Cost(size_t)> Measurement;
+
+// COUNTED checks are judged by comparisons, TIMED ones by time.
+enum Metric { COUNTED, TIMED };
+
+struct Check
+{
+    string name;
+    Complexity expected;
+    Metric metric;
+    int minLog, maxLog; // sizes 2^minLog .. 2^maxLog
+    Measurement measure;
+};
+
+// Key orders: the keys 1, 3, .., 2n - 1 shuffled (differently for each
+// seed) or sorted.
+typedef vector<uint64_t> (*KeyOrder)(size_t n, size_t seed);
+
+static vector<uint64_t> randomKeys(size_t n, size_t seed)
+{
+    vector<uint64_t> keys(n);
+    for (size_t i = 0; i < n; i++) keys[i] = i * 2 + 1;
+    shuffle(keys.begin(), keys.end(), mt19937_64(n * 1000003 + seed));
+    return keys;
+}
+
+static vector<uint64_t> sortedKeys(size_t n, size_t)
+{
+    vector<uint64_t> keys(n);
+    for (size_t i = 0; i < n; i++) keys[i] = i * 2 + 1;
+    return keys;
+}
+
+template<typename Tree>
+static void fill(Tree& tree, const vector<uint64_t>& keys)
+{
+    for (size_t i = 0; i < keys.size(); i++) tree.insert(make_pair(keys[i], keys[i]));
+}
+
+// A copy of a tree built from keys. Copying allocates the nodes in
+// preorder, so walks over the copy touch memory almost in order and only
+// the algorithm, not the cache, decides how their cost grows.
+template<typename Tree>
+static Tree compactTree(const vector<uint64_t>& keys)
+{
+    Tree tree;
+    fill(tree, keys);
+    return Tree(tree);
+}
+
+// batches of n operations to time for one sample
+static size_t batchesFor(size_t n)
+{
+    return n >= COMPLEXITY_MIN_OPS ? 1 : COMPLEXITY_MIN_OPS / n;
+}
+
+// count keys of a tree of n, picked at random, so a small tree cannot
+// teach the branch predictor its search paths
+static vector<uint64_t> probeKeys(size_t n, size_t count)
+{
+    mt19937_64 random(n);
+    uniform_int_distribution<uint64_t> index(0, n - 1);
+    vector<uint64_t> probes(count);
+    for (size_t i = 0; i < count; i++) probes[i] = index(random) * 2 + 1;
+    return probes;
+}
+
+// The operations, each measured over whole batches so one sample is not
+// dominated by the clock. Operations that change the tree start every
+// batch from a fresh tree, and random orders change between batches.
+
+template<typename Tree>
+static Cost timeInsert(size_t n, KeyOrder order)
+{
+    size_t batches = batchesFor(n);
+    Meter meter;
+    for (size_t b = 0; b < batches; b++)
+    {
+        vector<uint64_t> keys = order(n, b);
+        Tree tree;
+        meter.start();
+        fill(tree, keys);
+        meter.stop(n);
+    }
+    return meter.perOp();
+}
+
+template<typename Tree>
+static Cost timeFind(size_t n, KeyOrder order)
+{
+    Tree tree;
+    fill(tree, order(n, 0));
+    vector<uint64_t> probes = probeKeys(n, batchesFor(n) * n);
+    size_t hits = 0;
+    Meter meter;
+    meter.start();
+    for (size_t i = 0; i < probes.size(); i++) hits += tree.find(probes[i]) != tree.end();
+    meter.stop(probes.size());
+    if (hits != probes.size()) throw runtime_error("find missed");
+    return meter.perOp();
+}
+
+template<typename Tree>
+static Cost timeLowerBound(size_t n, KeyOrder order)
+{
+    Tree tree;
+    fill(tree, order(n, 0));
+    vector<uint64_t> probes = probeKeys(n, batchesFor(n) * n);
+    uint64_t sum = 0;
+    Meter meter;
+    meter.start();
+    for (size_t i = 0; i < probes.size(); i++) sum += tree.lowerBound(probes[i] - 1)->first.value;
+    meter.stop(probes.size());
+    if (sum == 0) throw runtime_error("lowerBound found nothing");
+    return meter.perOp();
+}
+
+// in random order, so removes from an AVL tree built from sorted keys
+// search like any other instead of following one path every time
+template<typename Tree>
+static Cost timeRemove(size_t n, KeyOrder order)
+{
+    Tree full = compactTree<Tree>(order(n, 0));
+    size_t batches = batchesFor(n);
+    Meter meter;
+    for (size_t b = 0; b < batches; b++)
+    {
+        vector<uint64_t> removeOrder = randomKeys(n, b + 1);
+        Tree tree(full);
+        meter.start();
+        for (size_t i = 0; i < n; i++) tree.remove(removeOrder[i]);
+        meter.stop(n);
+    }
+    return meter.perOp();
+}
+
+template<typename Tree>
+static Cost timeIterate(size_t n, KeyOrder order)
+{
+    Tree tree = compactTree<Tree>(order(n, 0));
+    size_t batches = batchesFor(n);
+    uint64_t sum = 0;
+    Meter meter;
+    meter.start();
+    for (size_t b = 0; b < batches; b++)
+    {
+        for (typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) sum += it->second;
+    }
+    meter.stop(batches * n);
+    if (sum == 0) throw runtime_error("iteration visited nothing");
+    return meter.perOp();
+}
+
+template<typename Tree>
+static Cost timeClear(size_t n, KeyOrder order)
+{
+    Tree full = compactTree<Tree>(order(n, 0));
+    size_t batches = batchesFor(n);
+    Meter meter;
+    for (size_t b = 0; b < batches; b++)
+    {
+        Tree tree(full);
+        meter.start();
+        tree.clear();
+        meter.stop(n);
+    }
+    return meter.perOp();
+}
+
+template<typename Tree>
+static Cost timeCopy(size_t n, KeyOrder order)
+{
+    Tree tree = compactTree<Tree>(order(n, 0));
+    size_t batches = batchesFor(n);
+    Meter meter;
+    for (size_t b = 0; b < batches; b++)
+    {
+        meter.start();
+        Tree copy(tree);
+        meter.stop(n);
+        if (copy.size() != tree.size()) throw runtime_error("copy lost items");
+    }
+    return meter.perOp();
+}
+
+static Cost timeBulkBuild(size_t n)
+{
+    size_t batches = batchesFor(n);
+    Meter meter;
+    for (size_t b = 0; b < batches; b++)
+    {
+        vector<uint64_t> keys = randomKeys(n, b);
+        vector<pair<CountedKey, uint64_t> > items(n);
+        for (size_t i = 0; i < n; i++) items[i] = make_pair(CountedKey(keys[i]), keys[i]);
+        AVL tree;
+        meter.start();
+        tree.bulkBuild(items, 1);
+        meter.stop(n);
+    }
+    return meter.perOp();
+}
+
+static Cost timeEraseRange(size_t n)
+{
+    AVL full = compactTree<AVL>(randomKeys(n, 0));
+    size_t batches = batchesFor(n);
+    Meter meter;
+    for (size_t b = 0; b < batches; b++)
+    {
+        AVL tree(full);
+        meter.start();
+        tree.eraseRange(n / 2, n * 3 / 2); // the middle half of the keys
+        meter.stop(n - tree.size());
+    }
+    return meter.perOp();
+}
+
+static Cost timeEraseIf(size_t n)
+{
+    AVL full = compactTree<AVL>(randomKeys(n, 0));
+    size_t batches = batchesFor(n);
+    Meter meter;
+    for (size_t b = 0; b < batches; b++)
+    {
+        AVL tree(full);
+        meter.start();
+        // keys are odd, so this removes every other one and takes the rebuild path
+        size_t erased = erase_if(tree, [](const pair<const CountedKey, uint64_t>& item) { return item.first.value % 4 == 1; });
+        meter.stop(n);
+        if (erased != n / 2) throw runtime_error("eraseIf removed the wrong items");
+    }
+    return meter.perOp();
+}
+
+// Operations on a tree built in the given order, where a search costs
+// search and an insert costs insertion, in comparisons. Searches are
+// measured on trees of 2^minLog .. 2^maxLog items.
+template<typename Tree>
+static void addChecks(vector<Check>& checks, const string& tree, Complexity search, Complexity insertion,
+                      int minLog, int maxLog, KeyOrder order)
+{
+    string name = order == randomKeys ? ", random order" : ", sorted order";
+    int timedMin = COMPLEXITY_TIMED_MIN_LOG, timedMax = COMPLEXITY_TIMED_MAX_LOG;
+    Check insert = { tree + "::insert" + name, insertion, COUNTED, minLog, maxLog,
+                     [=](size_t n) { return timeInsert<Tree>(n, order); } };
+    Check find = { tree + "::find" + name, search, COUNTED, minLog, maxLog,
+                   [=](size_t n) { return timeFind<Tree>(n, order); } };
+    Check lowerBound = { tree + "::lowerBound" + name, search, COUNTED, minLog, maxLog,
+                         [=](size_t n) { return timeLowerBound<Tree>(n, order); } };
+    Check remove = { tree + "::remove" + name, search, COUNTED, minLog, maxLog,
+                     [=](size_t n) { return timeRemove<Tree>(n, order); } };
+    Check iterate = { tree + "::iterator" + name, CONSTANT, TIMED, timedMin, timedMax,
+                      [=](size_t n) { return timeIterate<Tree>(n, order); } };
+    Check clear = { tree + "::clear" + name, CONSTANT, TIMED, timedMin, timedMax,
+                    [=](size_t n) { return timeClear<Tree>(n, order); } };
+    Check copy = { tree + "::copy" + name, CONSTANT, TIMED, timedMin, timedMax,
+                   [=](size_t n) { return timeCopy<Tree>(n, order); } };
+    checks.push_back(insert);
+    checks.push_back(find);
+    checks.push_back(lowerBound);
+    checks.push_back(remove);
+    checks.push_back(iterate);
+    checks.push_back(clear);
+    checks.push_back(copy);
+}
+
+/*
+ * Returns the class that fits the curve best: for each class, the cost
+ * per operation over f(n) is fitted as one constant by least squares in
+ * log space, and the class with the smallest spread around it wins.
+ */
+static Complexity classify(const vector<size_t>& sizes, const vector<double>& nanos)
+{
+    Complexity best = CONSTANT;
+    double bestError = HUGE_VAL;
+    for (int c = CONSTANT; c < NUM_COMPLEXITIES; c++)
+    {
+        vector<double> scaled(sizes.size());
+        double mean = 0;
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            scaled[i] = log(nanos[i] / complexityOf((Complexity)c, sizes[i]));
+            mean += scaled[i] / sizes.size();
+        }
+        double error = 0;
+        for (size_t i = 0; i < sizes.size(); i++) error += (scaled[i] - mean) * (scaled[i] - mean);
+        if (error < bestError)
+        {
+            best = (Complexity)c;
+            bestError = error;
+        }
+    }
+    return best;
+}
+
+static bool runCheck(const Check& check)
+{
+    vector<size_t> sizes;
+    vector<double> nanos, comparisons;
+    for (int exponent = check.minLog; exponent <= check.maxLog; exponent++)
+    {
+        size_t n = (size_t)1 << exponent;
+        Cost best = check.measure(n);
+        // comparisons are the same every time; only the time varies
+        for (int trial = 1; check.metric == TIMED && trial < COMPLEXITY_TRIALS; trial++)
+        {
+            best.nanos = min(best.nanos, check.measure(n).nanos);
+        }
+        sizes.push_back(n);
+        nanos.push_back(best.nanos);
+        comparisons.push_back(best.comparisons);
+    }
+    const vector<double>& costs = check.metric == COUNTED ? comparisons : nanos;
+    Complexity found = classify(sizes, costs);
+    bool pass = found == check.expected;
+
+    cout << (pass ? "ok    " : "FAIL  ") << check.name << ": expected " << complexityNames[check.expected]
+         << ", " << (check.metric == COUNTED ? "comparisons" : "time") << " fit " << complexityNames[found]
+         << " (" << costs.front() << " -> " << costs.back() << (check.metric == COUNTED ? " per op" : " ns/op")
+         << " for n = " << sizes.front() << " -> " << sizes.back() << ")" << endl;
+    return pass;
+}
+
+int main(int argc, char *argv[])
+{
+    string filter = argc > 1 ? argv[1] : "";
+
+    vector<Check> checks;
+    addChecks<BST>(checks, "BinarySearchTree", LOGARITHMIC, LOGARITHMIC, 6, 16, randomKeys);
+    // an unbalanced tree built from sorted keys is a list
+    addChecks<BST>(checks, "BinarySearchTree", LINEAR, LINEAR, 6, 12, sortedKeys);
+    addChecks<AVL>(checks, "AVLTree", LOGARITHMIC, LOGARITHMIC, 6, 16, randomKeys);
+    // sorted keys are appended through the rightmost finger
+    addChecks<AVL>(checks, "AVLTree", LOGARITHMIC, CONSTANT, 6, 16, sortedKeys);
+    // the sort makes O(log n) comparisons per item
+    Check bulkBuild = { "AVLTree::bulkBuild, random order", LOGARITHMIC, COUNTED, 6, 16,
+                        [](size_t n) { return timeBulkBuild(n); } };
+    Check eraseRange = { "AVLTree::eraseRange, random order", CONSTANT, TIMED,
+                         COMPLEXITY_TIMED_MIN_LOG, COMPLEXITY_TIMED_MAX_LOG, [](size_t n) { return timeEraseRange(n); } };
+    Check eraseIf = { "AVLTree::eraseIf, random order", CONSTANT, TIMED,
+                      COMPLEXITY_TIMED_MIN_LOG, COMPLEXITY_TIMED_MAX_LOG, [](size_t n) { return timeEraseIf(n); } };
+    checks.push_back(bulkBuild);
+    checks.push_back(eraseRange);
+    checks.push_back(eraseIf);
+
+    size_t failed = 0, run = 0;
+    for (size_t i = 0; i < checks.size(); i++)
+    {
+        if (checks[i].name.find(filter) == string::npos) continue;
+        run++;
+        if (!runCheck(checks[i])) failed++;
+    }
+    cout << run - failed << "/" << run << " complexity checks passed" << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,568 @@
+#ifndef DURABLEBST_H
+#define DURABLEBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "avlbst.h"
+
+/*
+ * Binary encoding of keys and values for the log and snapshots. The
+ * default copies the bytes of trivially copyable types; other types
+ * specialize it:
+ *
+ *   template<> struct WalCodec<MyType>
+ *   {
+ *       static void encode(std::string& out, const MyType& item);
+ *       static bool decode(const char*& pos, const char* end, MyType& item);
+ *   };
+ *
+ * decode advances pos past the item and returns false if the input ends
+ * early. Data is written in the machine's own byte order.
+ */
+template <typename T>
+struct WalCodec
+{
+    static void encode(std::string& out, const T& item)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "specialize WalCodec for this type");
+        out.append(reinterpret_cast<const char*>(&item), sizeof(T));
+    }
+
+    static bool decode(const char*& pos, const char* end, T& item)
+    {
+        if ((size_t)(end - pos) < sizeof(T)) return false;
+        std::memcpy(&item, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+};
+
+template <>
+struct WalCodec<std::string>
+{
+    static void encode(std::string& out, const std::string& item)
+    {
+        WalCodec<uint32_t>::encode(out, (uint32_t)item.size());
+        out += item;
+    }
+
+    static bool decode(const char*& pos, const char* end, std::string& item)
+    {
+        uint32_t length;
+        if (!WalCodec<uint32_t>::decode(pos, end, length) || (size_t)(end - pos) < length) return false;
+        item.assign(pos, length);
+        pos += length;
+        return true;
+    }
+};
+
+/**
+* Tuning for DurableAVLTree.
+*/
+struct DurabilityOptions
+{
+    DurabilityOptions() : groupCommitOps(64), checkpointBytes(64 << 20), sync(true) { }
+
+    size_t groupCommitOps;  // commit (write + fsync) after this many updates, 1 = every update
+    size_t checkpointBytes; // write a snapshot and start a new log once the log is this big, 0 = never
+    bool sync;              // fsync on commit; without it updates only survive a process crash
+};
+
+/**
+* An AVLTree whose updates survive crashes. Every insert/remove is first
+* appended to a write-ahead log (path + ".wal"); updates are written and
+* fsynced in groups, so the cost of an fsync is shared by a whole group.
+* Once the log grows past a limit the tree is written to a snapshot
+* (path + ".snap") and the log starts over.
+*
+* Opening a path recovers the tree: the snapshot is loaded, then the log
+* is replayed. A record torn by a crash ends the log and is cut off.
+* Updates since the last commit() (or automatic group commit) may be lost.
+* If a commit fails, the log is cut back to its last whole record so the
+* failed group can be retried; if even that fails, the tree refuses all
+* further updates, since anything logged after the torn group would be
+* lost on recovery.
+*
+* The tree itself can only be changed through this class; tree() gives
+* read access to everything else. File errors throw std::runtime_error.
+*/
+template <class Key, class Value>
+class DurableAVLTree
+{
+public:
+    typedef typename AVLTree<Key, Value>::iterator iterator;
+
+    DurableAVLTree(const std::string& path, const DurabilityOptions& options = DurabilityOptions());
+    ~DurableAVLTree();
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    void remove(const Key& key);
+    void commit();
+    void checkpoint();
+
+    iterator find(const Key& key) const;
+    iterator begin() const;
+    iterator end() const;
+    size_t size() const;
+    bool empty() const;
+    const AVLTree<Key, Value>& tree() const;
+
+protected:
+    enum { OP_INSERT = 1, OP_REMOVE = 2 };
+
+    DurableAVLTree(const DurableAVLTree<Key, Value>& other); // not copyable
+    DurableAVLTree<Key, Value>& operator=(const DurableAVLTree<Key, Value>& other);
+
+    void appendRecord(const std::string& payload);
+    void writePending();
+    void checkUsable() const;
+    void loadSnapshot();
+    void replayLog();
+    bool applyRecord(const char* pos, const char* end);
+    void openLog(bool truncate);
+
+    static uint32_t checksum(const char* data, size_t length);
+    static bool readFile(const std::string& path, std::string& contents);
+    static void writeAll(int fd, const char* data, size_t length, const std::string& path);
+    static void syncDirectory(const std::string& path);
+    static void fail(const std::string& what, const std::string& path);
+
+protected:
+    AVLTree<Key, Value> tree_;
+    DurabilityOptions options_;
+    std::string logPath_;
+    std::string snapshotPath_;
+    int logFd_;
+    std::string pending_;  // encoded records not yet written
+    size_t pendingOps_;
+    size_t logBytes_;      // bytes written to the current log
+    bool broken_;          // the log could not be repaired after a failed commit
+};
+
+// snapshot layout: magic, item count, encoded items, checksum of the count and items
+static const char DURABLE_SNAPSHOT_MAGIC[8] = { 'A', 'V', 'L', 'S', 'N', 'A', 'P', '2' };
+
+/**
+* Opens (or creates) the tree stored at path and recovers its contents.
+*/
+template<class Key, class Value>
+DurableAVLTree<Key, Value>::DurableAVLTree(const std::string& path, const DurabilityOptions& options) :
+    options_(options), logPath_(path + ".wal"), snapshotPath_(path + ".snap"),
+    logFd_(-1), pendingOps_(0), logBytes_(0), broken_(false)
+{
+    if (options_.groupCommitOps == 0) options_.groupCommitOps = 1;
+    loadSnapshot();
+    replayLog();
+}
+
+/**
+* Commits outstanding updates. Errors cannot be reported from here, so
+* call commit() first to find out whether the last group made it to disk.
+*/
+template<class Key, class Value>
+DurableAVLTree<Key, Value>::~DurableAVLTree()
+{
+    try
+    {
+        commit();
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+    if (logFd_ >= 0) close(logFd_);
+}
+
+/**
+* Logs and applies an insert (or overwrite).
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    checkUsable();
+    std::string payload(1, (char)OP_INSERT);
+    WalCodec<Key>::encode(payload, new_item.first);
+    WalCodec<Value>::encode(payload, new_item.second);
+    tree_.insert(new_item);
+    appendRecord(payload);
+}
+
+/**
+* Logs and applies a remove. Removing a missing key is not logged.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::remove(const Key& key)
+{
+    checkUsable();
+    if (tree_.find(key) == tree_.end()) return;
+
+    std::string payload(1, (char)OP_REMOVE);
+    WalCodec<Key>::encode(payload, key);
+    tree_.remove(key);
+    appendRecord(payload);
+}
+
+/**
+* Frames a record as [payload length][checksum][payload] and queues it,
+* committing once a whole group is queued.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::appendRecord(const std::string& payload)
+{
+    WalCodec<uint32_t>::encode(pending_, (uint32_t)payload.size());
+    WalCodec<uint32_t>::encode(pending_, checksum(payload.data(), payload.size()));
+    pending_ += payload;
+    if (++pendingOps_ >= options_.groupCommitOps) commit();
+}
+
+/**
+* Writes the queued updates to the log and fsyncs it. Returns once they
+* are durable. May start a checkpoint if the log has grown too big.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::commit()
+{
+    writePending();
+    if (options_.checkpointBytes != 0 && logBytes_ >= options_.checkpointBytes) checkpoint();
+}
+
+/*
+ * Appends the queued records to the log. If the write comes up short or
+ * the fsync fails, the log is cut back to its last whole record and the
+ * records stay queued for the next commit, so a torn group never sits
+ * in front of later ones.
+ */
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::writePending()
+{
+    checkUsable();
+    if (pending_.empty()) return;
+
+    try
+    {
+        writeAll(logFd_, pending_.data(), pending_.size(), logPath_);
+        if (options_.sync && fsync(logFd_) != 0) fail("cannot sync", logPath_);
+    }
+    catch (const std::runtime_error&)
+    {
+        int error = errno;
+        if (ftruncate(logFd_, logBytes_) != 0 || fsync(logFd_) != 0) broken_ = true;
+        errno = error;
+        throw;
+    }
+    logBytes_ += pending_.size();
+    pending_.clear();
+    pendingOps_ = 0;
+}
+
+/*
+ * Throws once a failed commit has left the log in a state that cannot be
+ * appended to safely.
+ */
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::checkUsable() const
+{
+    if (broken_) throw std::runtime_error("log damaged by a failed commit: " + logPath_);
+}
+
+/**
+* Commits queued updates, then writes the whole tree to a new snapshot
+* and empties the log. The snapshot replaces the old one atomically. Since
+* the log holds every update in the snapshot, a crash that leaves the old
+* log behind only replays updates the snapshot already has, and replaying
+* them over it gives the same tree.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::checkpoint()
+{
+    writePending();
+
+    std::string items;
+    for (iterator it = tree_.begin(); it != tree_.end(); ++it)
+    {
+        WalCodec<Key>::encode(items, it->first);
+        WalCodec<Value>::encode(items, it->second);
+    }
+    std::string contents(DURABLE_SNAPSHOT_MAGIC, sizeof(DURABLE_SNAPSHOT_MAGIC));
+    WalCodec<uint64_t>::encode(contents, (uint64_t)tree_.size());
+    contents += items;
+    size_t body = sizeof(DURABLE_SNAPSHOT_MAGIC);
+    WalCodec<uint32_t>::encode(contents, checksum(contents.data() + body, contents.size() - body));
+
+    std::string tempPath = snapshotPath_ + ".tmp";
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) fail("cannot create", tempPath);
+    try
+    {
+        writeAll(fd, contents.data(), contents.size(), tempPath);
+        if (fsync(fd) != 0) fail("cannot sync", tempPath);
+    }
+    catch (const std::runtime_error&)
+    {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    if (rename(tempPath.c_str(), snapshotPath_.c_str()) != 0) fail("cannot rename to", snapshotPath_);
+    syncDirectory(snapshotPath_);
+
+    openLog(true);
+}
+
+/**
+* Loads the snapshot, if there is one. A damaged snapshot is an error: it
+* is only ever replaced whole, so it cannot be torn by a crash. The item
+* count is covered by the checksum, and the items must fill the space up
+* to it exactly.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::loadSnapshot()
+{
+    std::string contents;
+    if (!readFile(snapshotPath_, contents)) return;
+
+    const char* pos = contents.data();
+    const char* end = pos + contents.size();
+    uint64_t count = 0;
+    if (contents.size() < sizeof(DURABLE_SNAPSHOT_MAGIC) + sizeof(uint64_t) + sizeof(uint32_t)
+        || std::memcmp(pos, DURABLE_SNAPSHOT_MAGIC, sizeof(DURABLE_SNAPSHOT_MAGIC)) != 0)
+    {
+        throw std::runtime_error("not a snapshot: " + snapshotPath_);
+    }
+    pos += sizeof(DURABLE_SNAPSHOT_MAGIC);
+
+    const char* itemsEnd = end - sizeof(uint32_t);
+    const char* tail = itemsEnd;
+    uint32_t expected;
+    WalCodec<uint32_t>::decode(tail, end, expected);
+    if (checksum(pos, itemsEnd - pos) != expected) throw std::runtime_error("corrupt snapshot: " + snapshotPath_);
+    WalCodec<uint64_t>::decode(pos, itemsEnd, count);
+
+    // every item takes at least one byte, which bounds the reservation
+    std::vector<std::pair<Key, Value> > items;
+    items.reserve((size_t)std::min<uint64_t>(count, itemsEnd - pos));
+    for (uint64_t i = 0; i < count; i++)
+    {
+        std::pair<Key, Value> item;
+        if (!WalCodec<Key>::decode(pos, itemsEnd, item.first) || !WalCodec<Value>::decode(pos, itemsEnd, item.second))
+        {
+            throw std::runtime_error("corrupt snapshot: " + snapshotPath_);
+        }
+        items.push_back(item);
+    }
+    if (pos != itemsEnd) throw std::runtime_error("corrupt snapshot: " + snapshotPath_);
+    // written in key order, so bulkBuild skips the sort
+    tree_.bulkBuild(items);
+}
+
+/**
+* Replays the log over the snapshot, cuts off a torn record at the end
+* and reopens the log for appending.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::replayLog()
+{
+    std::string contents;
+    bool exists = readFile(logPath_, contents);
+
+    const char* start = contents.data();
+    const char* pos = start;
+    const char* end = start + contents.size();
+    while (true)
+    {
+        const char* record = pos;
+        uint32_t length, expected;
+        if (!WalCodec<uint32_t>::decode(pos, end, length) || !WalCodec<uint32_t>::decode(pos, end, expected)
+            || (size_t)(end - pos) < length || checksum(pos, length) != expected || !applyRecord(pos, pos + length))
+        {
+            pos = record;
+            break;
+        }
+        pos += length;
+    }
+    logBytes_ = pos - start;
+
+    openLog(!exists);
+    if (logBytes_ != contents.size())
+    {
+        if (ftruncate(logFd_, logBytes_) != 0) fail("cannot truncate", logPath_);
+        if (fsync(logFd_) != 0) fail("cannot sync", logPath_);
+    }
+}
+
+/**
+* Applies one decoded log record. Returns false if it is malformed.
+*/
+template<class Key, class Value>
+bool DurableAVLTree<Key, Value>::applyRecord(const char* pos, const char* end)
+{
+    if (pos == end) return false;
+    char op = *pos++;
+    Key key;
+    if (!WalCodec<Key>::decode(pos, end, key)) return false;
+    if (op == OP_INSERT)
+    {
+        Value value;
+        if (!WalCodec<Value>::decode(pos, end, value) || pos != end) return false;
+        tree_.insert(std::make_pair(key, value));
+        return true;
+    }
+    if (op == OP_REMOVE && pos == end)
+    {
+        tree_.remove(key);
+        return true;
+    }
+    return false;
+}
+
+/**
+* Opens the log for appending, emptying it first if truncate is set.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::openLog(bool truncate)
+{
+    if (logFd_ >= 0) close(logFd_);
+    logFd_ = open(logPath_.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+    if (logFd_ < 0) fail("cannot open", logPath_);
+    if (truncate)
+    {
+        logBytes_ = 0;
+        if (fsync(logFd_) != 0) fail("cannot sync", logPath_);
+        syncDirectory(logPath_);
+    }
+}
+
+template<class Key, class Value>
+typename DurableAVLTree<Key, Value>::iterator DurableAVLTree<Key, Value>::find(const Key& key) const
+{
+    return tree_.find(key);
+}
+
+template<class Key, class Value>
+typename DurableAVLTree<Key, Value>::iterator DurableAVLTree<Key, Value>::begin() const
+{
+    return tree_.begin();
+}
+
+template<class Key, class Value>
+typename DurableAVLTree<Key, Value>::iterator DurableAVLTree<Key, Value>::end() const
+{
+    return tree_.end();
+}
+
+template<class Key, class Value>
+size_t DurableAVLTree<Key, Value>::size() const
+{
+    return tree_.size();
+}
+
+template<class Key, class Value>
+bool DurableAVLTree<Key, Value>::empty() const
+{
+    return tree_.empty();
+}
+
+template<class Key, class Value>
+const AVLTree<Key, Value>& DurableAVLTree<Key, Value>::tree() const
+{
+    return tree_;
+}
+
+/*
+ * FNV-1a; enough to tell a torn or garbled record from a whole one.
+ */
+template<class Key, class Value>
+uint32_t DurableAVLTree<Key, Value>::checksum(const char* data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Reads a whole file. Returns false if it does not exist.
+ */
+template<class Key, class Value>
+bool DurableAVLTree<Key, Value>::readFile(const std::string& path, std::string& contents)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        if (errno == ENOENT) return false;
+        fail("cannot open", path);
+    }
+
+    char buffer[1 << 16];
+    while (true)
+    {
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0)
+        {
+            int error = errno;
+            close(fd);
+            errno = error;
+            fail("cannot read", path);
+        }
+        if (got == 0) break;
+        contents.append(buffer, got);
+    }
+    close(fd);
+    return true;
+}
+
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::writeAll(int fd, const char* data, size_t length, const std::string& path)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0) fail("cannot write", path);
+        data += written;
+        length -= written;
+    }
+}
+
+/*
+ * Makes a rename or file creation in the directory holding path durable.
+ */
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::syncDirectory(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd < 0) fail("cannot open", directory);
+    if (fsync(fd) != 0)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        fail("cannot sync", directory);
+    }
+    close(fd);
+}
+
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::fail(const std::string& what, const std::string& path)
+{
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef RECCHECK
+#include <vector>
+#include <utility>
+#include <algorithm>
+#endif
+
+#include "equal-paths-batch.h"
+using namespace std;
+
+// trees handed out per grab from the shared counter
+static const size_t BATCH_CHUNK = 64;
+
+// Walks one tree and records its shallowest and deepest leaf.
+static void leafDepths(Node* root, vector<pair<Node*, int> >& stack, PathDepths& result)
+{
+    result.equal = true;
+    result.minLeafDepth = 0;
+    result.maxLeafDepth = 0;
+    if (root == nullptr) return;
+
+    stack.clear();
+    stack.push_back(make_pair(root, 1));
+    while (!stack.empty())
+    {
+        Node* currentNode = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+
+        if (currentNode->left == nullptr && currentNode->right == nullptr)
+        {
+            if (result.minLeafDepth == 0 || depth < result.minLeafDepth) result.minLeafDepth = depth;
+            if (depth > result.maxLeafDepth) result.maxLeafDepth = depth;
+            continue;
+        }
+        if (currentNode->right != nullptr) stack.push_back(make_pair(currentNode->right, depth + 1));
+        if (currentNode->left != nullptr) stack.push_back(make_pair(currentNode->left, depth + 1));
+    }
+    result.equal = result.minLeafDepth == result.maxLeafDepth;
+}
+
+void equalPathsBatch(Node* const* roots, size_t count, PathDepths* results, EqualPathsPool* pool)
+{
+    if (pool != nullptr)
+    {
+        pool->run(roots, count, results);
+        return;
+    }
+
+    static thread_local vector<pair<Node*, int> > stack;
+    for (size_t i = 0; i < count; i++)
+    {
+        leafDepths(roots[i], stack, results[i]);
+    }
+}
+
+EqualPathsPool::EqualPathsPool(unsigned threads) :
+    roots_(nullptr), count_(0), results_(nullptr), next_(0), generation_(0), busy_(0), stop_(false)
+{
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    for (unsigned i = 1; i < threads; i++)
+    {
+        workers_.push_back(thread(&EqualPathsPool::workerLoop, this));
+    }
+}
+
+EqualPathsPool::~EqualPathsPool()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++) workers_[i].join();
+}
+
+void EqualPathsPool::run(Node* const* roots, size_t count, PathDepths* results)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        roots_ = roots;
+        count_ = count;
+        results_ = results;
+        next_ = 0;
+        busy_ = (unsigned)workers_.size();
+        generation_++;
+    }
+    wake_.notify_all();
+
+    // the calling thread takes a share of the work too
+    static thread_local vector<pair<Node*, int> > stack;
+    work(stack);
+
+    unique_lock<mutex> lock(mutex_);
+    while (busy_ != 0) finished_.wait(lock);
+}
+
+void EqualPathsPool::workerLoop()
+{
+    vector<pair<Node*, int> > stack;
+    unsigned seen = 0;
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(mutex_);
+            while (!stop_ && generation_ == seen) wake_.wait(lock);
+            if (stop_) return;
+            seen = generation_;
+        }
+
+        work(stack);
+
+        lock_guard<mutex> lock(mutex_);
+        if (--busy_ == 0) finished_.notify_one();
+    }
+}
+
+void EqualPathsPool::work(vector<pair<Node*, int> >& stack)
+{
+    while (true)
+    {
+        size_t first = next_.fetch_add(BATCH_CHUNK);
+        if (first >= count_) return;
+        size_t last = min(count_, first + BATCH_CHUNK);
+        for (size_t i = first; i < last; i++)
+        {
+            leafDepths(roots_[i], stack, results_[i]);
+        }
+    }
+}
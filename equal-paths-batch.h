@@ -0,0 +1,68 @@
+#ifndef EQUAL_PATHS_BATCH_H
+#define EQUAL_PATHS_BATCH_H
+
+#ifndef RECCHECK
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#endif
+
+#include "equal-paths.h"
+
+/**
+ * @brief Leaf depth summary of one tree. Depths count the root as 1;
+ *        an empty tree reports equal = true and depths of 0.
+ */
+struct PathDepths {
+    bool equal;
+    int minLeafDepth;
+    int maxLeafDepth;
+};
+
+/**
+ * @brief A fixed set of worker threads that equalPathsBatch can spread
+ *        trees over. Each worker keeps its own traversal stack, so its
+ *        memory is reused from one batch to the next.
+ *
+ *        Only one batch may run on a pool at a time.
+ */
+class EqualPathsPool {
+public:
+    // threads counts the calling thread too; 0 means every hardware thread
+    explicit EqualPathsPool(unsigned threads = 0);
+    ~EqualPathsPool();
+
+    void run(Node* const* roots, size_t count, PathDepths* results);
+
+private:
+    EqualPathsPool(const EqualPathsPool&);
+    EqualPathsPool& operator=(const EqualPathsPool&);
+
+    void workerLoop();
+    void work(std::vector<std::pair<Node*, int> >& stack);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    Node* const* roots_;
+    size_t count_;
+    PathDepths* results_;
+    std::atomic<size_t> next_;
+    unsigned generation_;
+    unsigned busy_;
+    bool stop_;
+};
+
+/**
+ * @brief Computes the leaf depth summary of count trees, writing
+ *        results[i] for roots[i]. Trees are walked iteratively with a
+ *        per-thread stack that is reused across calls. If pool is not
+ *        NULL the trees are distributed over its threads.
+ */
+void equalPathsBatch(Node* const* roots, size_t count, PathDepths* results, EqualPathsPool* pool = NULL);
+
+#endif
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include "equal-paths.h"
+using namespace std;
+
+// Times equalPaths on large trees:
+//   balanced     - perfect tree, every leaf must be visited (result 1)
+//   late miss    - perfect tree whose last leaf in visit order is missing (result 0)
+//   deep chain   - a single path of n nodes, far deeper than recursion allows (result 1)
+//   caterpillar  - long spine with a leaf on every node, mismatch found at once (result 0)
+//   usage: ./equal-paths-bench [log2 of node count]
+
+// Builds a perfect tree of the given height into nodes, returns the root.
+Node* buildPerfect(vector<Node>& nodes, int height)
+{
+    size_t count = (size_t(1) << height) - 1;
+    nodes.clear();
+    nodes.reserve(count);
+    for (size_t i = 0; i < count; i++) nodes.push_back(Node((int)i));
+    // heap layout: children of i are 2i+1 and 2i+2
+    for (size_t i = 0; 2 * i + 2 < count; i++)
+    {
+        nodes[i].left = &nodes[2 * i + 1];
+        nodes[i].right = &nodes[2 * i + 2];
+    }
+    return &nodes[0];
+}
+
+Node* buildChain(vector<Node>& nodes, size_t count, bool withLeaves)
+{
+    nodes.clear();
+    nodes.reserve(2 * count);
+    for (size_t i = 0; i < count; i++)
+    {
+        nodes.push_back(Node((int)i));
+        if (withLeaves) nodes.push_back(Node((int)i));
+    }
+    size_t step = withLeaves ? 2 : 1;
+    for (size_t i = 0; i + step < nodes.size(); i += step)
+    {
+        nodes[i].right = &nodes[i + step];
+        if (withLeaves) nodes[i].left = &nodes[i + 1];
+    }
+    return &nodes[0];
+}
+
+void report(const char* name, Node* root)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool result = equalPaths(root);
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    cout << name << ": " << result << " in "
+         << chrono::duration<double, milli>(stop - start).count() << " ms" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int height = argc > 1 ? atoi(argv[1]) : 22;
+    size_t count = (size_t(1) << height) - 1;
+    vector<Node> nodes;
+    cout << "nodes=" << count << endl;
+
+    report("balanced   ", buildPerfect(nodes, height));
+
+    // the rightmost leaves are visited last; dropping them makes their parent a leaf one level up
+    Node* root = buildPerfect(nodes, height);
+    nodes[(count - 2) / 2].left = nullptr;
+    nodes[(count - 2) / 2].right = nullptr;
+    report("late miss  ", root);
+
+    report("deep chain ", buildChain(nodes, count, false));
+    report("caterpillar", buildChain(nodes, count / 2, true));
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cstdlib>
 #include "equal-paths.h"
+#include "equal-paths-batch.h"
 using namespace std;
 
 
@@ -55,6 +56,32 @@ void test5(const char* msg)
   cout << msg << ": " <<   equalPaths(a) << endl;
 }
 
+void testBatch(const char* msg, EqualPathsPool* pool)
+{
+  // the trees of test1..test5 rebuilt side by side
+  Node* nodes[12];
+  for(int i = 0; i < 12; i++) nodes[i] = new Node(i);
+  setNode(nodes[1],2,NULL,NULL);
+  setNode(nodes[0],1,nodes[1],NULL);
+  setNode(nodes[3],2,NULL,NULL);
+  setNode(nodes[4],3,NULL,NULL);
+  setNode(nodes[2],1,nodes[3],nodes[4]);
+  setNode(nodes[6],4,NULL,NULL);
+  setNode(nodes[7],2,NULL,nodes[6]);
+  setNode(nodes[8],3,NULL,NULL);
+  setNode(nodes[5],1,nodes[7],nodes[8]);
+
+  Node* roots[5] = { nodes[9], nodes[0], nodes[2], nodes[5], NULL };
+  PathDepths results[5];
+  equalPathsBatch(roots, 5, results, pool);
+  for(int i = 0; i < 5; i++)
+  {
+    cout << msg << "[" << i << "]: " << results[i].equal << " "
+         << results[i].minLeafDepth << " " << results[i].maxLeafDepth << endl;
+  }
+  for(int i = 0; i < 12; i++) delete nodes[i];
+}
+
 int main()
 {
   a = new Node(1);
@@ -67,6 +94,10 @@ int main()
   test3("Test3");
   test4("Test4");
   test5("Test5");
+
+  testBatch("Batch", NULL);
+  EqualPathsPool pool(4);
+  testBatch("PoolBatch", &pool);
  
   delete a;
   delete b;
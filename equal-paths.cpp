@@ -1,6 +1,7 @@
 #ifndef RECCHECK
 //if you want to add any #includes like <iostream> you must do them here (before the next endif)
-
+#include <vector>
+#include <utility>
 #endif
 
 #include "equal-paths.h"
@@ -9,48 +10,38 @@ using namespace std;
 
 // You may add any prototypes of helper functions here
 
-void calculateMaxHeight(Node* root, int currentHeight, int& maxHeight)
-{
-    currentHeight++;
-    
-    if (root->left == nullptr && root->right == nullptr)
-    {
-        if (currentHeight > maxHeight) maxHeight = currentHeight;
-        return;
-    }
-    
-    
-    if (root->left != nullptr) calculateMaxHeight(root->left, currentHeight, maxHeight);
-    if (root->right != nullptr) calculateMaxHeight(root->right, currentHeight, maxHeight);
-}
-
-void calculateMinHeight(Node* root, int currentHeight, int& minHeight)
-{
-    currentHeight++;
-    
-    if (root->left == nullptr && root->right == nullptr)
-    {
-        if (currentHeight < minHeight) minHeight = currentHeight;
-        return;
-    }
-    
-    
-    if (root->left != nullptr) calculateMinHeight(root->left, currentHeight, minHeight);
-    if (root->right != nullptr) calculateMinHeight(root->right, currentHeight, minHeight);
-}
 
 bool equalPaths(Node * root)
 {
     // Add your code below
     if (root == nullptr) return true;
-    
-    int maxHeight = 0, minHeight = 99999;
-    calculateMaxHeight(root, 0, maxHeight);
-    calculateMinHeight(root, 0, minHeight);
-    
-    if (maxHeight == minHeight) return true;
-    else return false;
-    
 
+    // Iterative depth-first walk with an explicit stack, so very deep
+    // trees cannot overflow the call stack. Only one pass is made: the
+    // first leaf fixes the expected depth and any other depth aborts.
+    vector<pair<Node*, int> > stack;
+    stack.push_back(make_pair(root, 1));
+    int leafDepth = 0; // 0 until the first leaf is seen
+
+    while (!stack.empty())
+    {
+        Node* currentNode = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+
+        if (currentNode->left == nullptr && currentNode->right == nullptr)
+        {
+            if (leafDepth == 0) leafDepth = depth;
+            else if (depth != leafDepth) return false;
+            continue;
+        }
+
+        // every leaf below an internal node at this depth would be too deep
+        if (leafDepth != 0 && depth >= leafDepth) return false;
+
+        if (currentNode->right != nullptr) stack.push_back(make_pair(currentNode->right, depth + 1));
+        if (currentNode->left != nullptr) stack.push_back(make_pair(currentNode->left, depth + 1));
+    }
+    return true;
 }
 
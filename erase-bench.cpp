@@ -0,0 +1,89 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Expires the oldest quarter of a tree keyed by timestamp, once with a
+// remove() per key and once with a single eraseRange(). Then deletes
+// several fractions of a tree built from random keys by predicate, once
+// with a remove() per matching key and once with erase_if().
+//   usage: ./erase-bench [numItems]
+
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+static void fill(Tree& tree, size_t numItems)
+{
+    vector<pair<uint64_t, uint64_t> > items(numItems);
+    for (size_t i = 0; i < numItems; i++) items[i] = make_pair(i, i);
+    tree.bulkBuild(items);
+}
+
+static double millisSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// values are random, so value % 100 < percent picks about percent% of the items
+static void eraseByPredicate(const vector<uint64_t>& keys, uint64_t percent)
+{
+    double perKeyMs, eraseIfMs;
+    size_t removed, erased;
+    {
+        Tree perKey;
+        for (size_t i = 0; i < keys.size(); i++) perKey.insert(make_pair(keys[i], keys[i] >> 7));
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        vector<uint64_t> doomed;
+        for (Tree::iterator it = perKey.begin(); it != perKey.end(); ++it)
+        {
+            if (it->second % 100 < percent) doomed.push_back(it->first);
+        }
+        for (size_t i = 0; i < doomed.size(); i++) perKey.remove(doomed[i]);
+        perKeyMs = millisSince(start);
+        removed = doomed.size();
+    }
+    {
+        Tree predicated;
+        for (size_t i = 0; i < keys.size(); i++) predicated.insert(make_pair(keys[i], keys[i] >> 7));
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        erased = erase_if(predicated, [percent](const pair<const uint64_t, uint64_t>& item) {
+            return item.second % 100 < percent;
+        });
+        eraseIfMs = millisSince(start);
+    }
+
+    cout << "delete " << percent << (percent < 10 ? "% : " : "%: ") << "remove per key " << perKeyMs
+         << " ms, erase_if " << eraseIfMs << " ms" << (erased == removed ? "" : " (trees disagree)") << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t numItems = argc > 1 ? atol(argv[1]) : 2000000;
+    uint64_t cutoff = numItems / 4;
+
+    Tree perKey, ranged;
+    fill(perKey, numItems);
+    fill(ranged, numItems);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint64_t key = 0; key < cutoff; key++) perKey.remove(key);
+    chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+    ranged.eraseRange(0, cutoff - 1);
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    cout << "items=" << numItems << " expired=" << cutoff << endl;
+    cout << "remove per key : " << chrono::duration<double, milli>(middle - start).count() << " ms" << endl;
+    cout << "eraseRange     : " << chrono::duration<double, milli>(stop - middle).count() << " ms" << endl;
+    cout << "trees agree    : " << (perKey.begin()->first == ranged.begin()->first ? "yes" : "no") << endl;
+
+    mt19937_64 rng(50);
+    vector<uint64_t> keys(numItems / 2);
+    for (size_t i = 0; i < keys.size(); i++) keys[i] = rng();
+    uint64_t percents[] = { 1, 5, 10, 30, 60 };
+    for (size_t p = 0; p < 5; p++) eraseByPredicate(keys, percents[p]);
+    return 0;
+}
@@ -0,0 +1,292 @@
+#ifndef EXPORT_BST_H
+#define EXPORT_BST_H
+
+#include <deque>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+
+// BST export to Graphviz DOT and JSON
+//
+// Unlike printRoot(), which is limited to a few levels, the exporters
+// stream nodes out breadth-first as they are visited. They keep only the
+// queue of pending nodes, so the cost is O(visited nodes) for any tree
+// height. Output can be limited to the neighbourhood of a key, to a number
+// of levels, to a node budget, and/or to a sample of the child links.
+
+/**
+* Controls which part of the tree is exported.
+*/
+template<typename Key>
+struct ExportOptions
+{
+    ExportOptions() : hasCenter(false), center(), ancestorLevels(0), maxDepth(-1), maxNodes(0), sampleEvery(1) { }
+
+    // Start at the node holding key (or where the key would be), then
+    // move up levelsUp ancestors so some context around it is included.
+    ExportOptions& around(const Key& key, int levelsUp)
+    {
+        hasCenter = true;
+        center = key;
+        ancestorLevels = levelsUp;
+        return *this;
+    }
+
+    // Follow about one in every `every` child links, picked pseudo-randomly but
+    // the same on every run. A node keeps at least one child, so each
+    // exported path runs down to a leaf and a spread of paths through a
+    // huge tree fits in the node budget.
+    ExportOptions& sample(size_t every)
+    {
+        sampleEvery = every == 0 ? 1 : every;
+        return *this;
+    }
+
+    // Which children (bit 0 left, bit 1 right) of a node at depth to
+    // export, with exported ids handed out so far. links counts the child
+    // links sampled so far.
+    int follow(int depth, size_t exported, bool hasLeft, bool hasRight, size_t& links) const
+    {
+        if (maxDepth >= 0 && depth >= maxDepth) return 0;
+        int children = (hasLeft ? 1 : 0) | (hasRight ? 2 : 0);
+        if (sampleEvery > 1 && children != 0)
+        {
+            int kept = 0;
+            for (int side = 0; side < 2; side++)
+            {
+                if ((children >> side & 1) && sampleHash(links++) % sampleEvery == 0) kept |= 1 << side;
+            }
+            if (kept == 0) kept = children == 3 ? 1 << (sampleHash(links++) & 1) : children;
+            children = kept;
+        }
+        // the budget goes to the left child first
+        if (maxNodes != 0 && exported >= maxNodes) return 0;
+        if (maxNodes != 0 && children == 3 && exported + 1 >= maxNodes) children = 1;
+        return children;
+    }
+
+    // splitmix64 finalizer: spreads consecutive link numbers
+    static uint64_t sampleHash(uint64_t link)
+    {
+        link = (link ^ (link >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        link = (link ^ (link >> 27)) * 0x94d049bb133111ebULL;
+        return link ^ (link >> 31);
+    }
+
+    bool hasCenter;
+    Key center;
+    int ancestorLevels;
+    int maxDepth;    // levels below the start node to include, -1 for all
+    size_t maxNodes; // stop after this many nodes (top levels first), 0 for no limit
+    size_t sampleEvery; // follow one in this many child links, 1 for all
+};
+
+// Writes s with the characters that need escaping in DOT and JSON strings escaped.
+inline void exportEscaped(std::ostream& os, const std::string& s)
+{
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        char c = s[i];
+        if (c == '"' || c == '\\') os << '\\' << c;
+        else if (c == '\n') os << "\\n";
+        else if ((unsigned char)c < 0x20) os << ' ';
+        else os << c;
+    }
+}
+
+// Integers are promoted so that int8_t and uint8_t print as numbers.
+template<typename T>
+void exportJsonNumber(std::ostream& os, const T& item, std::false_type)
+{
+    os << +item;
+}
+
+// JSON has no NaN or infinity; floating point values round-trip.
+template<typename T>
+void exportJsonNumber(std::ostream& os, const T& item, std::true_type)
+{
+    if (!std::isfinite(item))
+    {
+        os << "null";
+        return;
+    }
+    std::streamsize precision = os.precision(std::numeric_limits<T>::max_digits10);
+    os << item;
+    os.precision(precision);
+}
+
+// Writes item as a JSON number (or true/false) when it is arithmetic,
+// otherwise as a string.
+template<typename T>
+void exportJsonScalar(std::ostream& os, const T& item, std::true_type)
+{
+    exportJsonNumber(os, item, std::is_floating_point<T>());
+}
+
+inline void exportJsonScalar(std::ostream& os, const bool& item, std::true_type)
+{
+    os << (item ? "true" : "false");
+}
+
+template<typename T>
+void exportJsonScalar(std::ostream& os, const T& item, std::false_type)
+{
+    std::ostringstream text;
+    text << item;
+    os << '"';
+    exportEscaped(os, text.str());
+    os << '"';
+}
+
+template<typename T>
+void exportJsonScalar(std::ostream& os, const T& item)
+{
+    exportJsonScalar(os, item, std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, char>::value>());
+}
+
+template<typename T>
+void exportDotLabel(std::ostream& os, const T& item)
+{
+    std::ostringstream text;
+    text << item;
+    exportEscaped(os, text.str());
+}
+
+/**
+* Finds the node the export starts at.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::exportStart(const ExportOptions<Key>& options) const
+{
+    if (!options.hasCenter) return root_;
+
+    Node<Key, Value>* startNode = root_;
+    Node<Key, Value>* currentNode = root_;
+    while (currentNode != nullptr)
+    {
+        startNode = currentNode;
+        if (currentNode->getKey() == options.center) break;
+        if (options.center < currentNode->getKey()) currentNode = currentNode->getLeft();
+        else currentNode = currentNode->getRight();
+    }
+    for (int i = 0; i < options.ancestorLevels && startNode != nullptr && startNode->getParent() != nullptr; i++)
+    {
+        startNode = startNode->getParent();
+    }
+    return startNode;
+}
+
+/**
+* Writes the selected part of the tree as a Graphviz digraph. Nodes whose
+* children were cut off by the limits get a dashed "..." child.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::exportDot(std::ostream& os, const ExportOptions<Key>& options) const
+{
+    os << "digraph BST {\n";
+    os << "  node [shape=box, fontname=\"monospace\"];\n";
+
+    // (node, id, depth below the start node)
+    std::deque<std::pair<Node<Key, Value>*, std::pair<size_t, int> > > pending;
+    Node<Key, Value>* startNode = exportStart(options);
+    size_t nextId = 0;
+    size_t links = 0;
+    if (startNode != nullptr) pending.push_back(std::make_pair(startNode, std::make_pair(nextId++, 0)));
+
+    while (!pending.empty())
+    {
+        Node<Key, Value>* currentNode = pending.front().first;
+        size_t id = pending.front().second.first;
+        int depth = pending.front().second.second;
+        pending.pop_front();
+
+        os << "  n" << id << " [label=\"";
+        exportDotLabel(os, currentNode->getKey());
+        os << ": ";
+        exportDotLabel(os, currentNode->getValue());
+        os << "\"];\n";
+
+        Node<Key, Value>* children[2] = { currentNode->getLeft(), currentNode->getRight() };
+        int followed = options.follow(depth, nextId, children[0] != nullptr, children[1] != nullptr, links);
+        for (int side = 0; side < 2; side++)
+        {
+            if (children[side] == nullptr) continue;
+            if (followed >> side & 1)
+            {
+                size_t childId = nextId++;
+                pending.push_back(std::make_pair(children[side], std::make_pair(childId, depth + 1)));
+                os << "  n" << id << " -> n" << childId << " [label=\"" << (side == 0 ? "L" : "R") << "\"];\n";
+            }
+            else
+            {
+                os << "  t" << id << "_" << side << " [label=\"...\", style=dashed];\n";
+                os << "  n" << id << " -> t" << id << "_" << side << " [style=dashed];\n";
+            }
+        }
+    }
+    os << "}\n";
+}
+
+/**
+* Writes the selected part of the tree as JSON:
+*   {"root": id, "nodes": [{"id", "key", "value", "left", "right", "truncated"}, ...]}
+* Child ids are null when there is no child or it was cut off; truncated
+* is true if a child exists but was not exported. Arithmetic keys and
+* values are written as numbers (bool as true/false, NaN and infinities
+* as null), anything else as a string.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::exportJson(std::ostream& os, const ExportOptions<Key>& options) const
+{
+    std::deque<std::pair<Node<Key, Value>*, std::pair<size_t, int> > > pending;
+    Node<Key, Value>* startNode = exportStart(options);
+    size_t nextId = 0;
+    size_t links = 0;
+    if (startNode != nullptr) pending.push_back(std::make_pair(startNode, std::make_pair(nextId++, 0)));
+
+    os << "{\"root\": ";
+    if (startNode == nullptr) os << "null";
+    else os << 0;
+    os << ", \"nodes\": [";
+
+    bool first = true;
+    while (!pending.empty())
+    {
+        Node<Key, Value>* currentNode = pending.front().first;
+        size_t id = pending.front().second.first;
+        int depth = pending.front().second.second;
+        pending.pop_front();
+
+        os << (first ? "\n" : ",\n") << "  {\"id\": " << id << ", \"key\": ";
+        first = false;
+        exportJsonScalar(os, currentNode->getKey());
+        os << ", \"value\": ";
+        exportJsonScalar(os, currentNode->getValue());
+
+        bool truncated = false;
+        Node<Key, Value>* children[2] = { currentNode->getLeft(), currentNode->getRight() };
+        int followed = options.follow(depth, nextId, children[0] != nullptr, children[1] != nullptr, links);
+        for (int side = 0; side < 2; side++)
+        {
+            os << (side == 0 ? ", \"left\": " : ", \"right\": ");
+            if (followed >> side & 1)
+            {
+                size_t childId = nextId++;
+                pending.push_back(std::make_pair(children[side], std::make_pair(childId, depth + 1)));
+                os << childId;
+            }
+            else
+            {
+                if (children[side] != nullptr) truncated = true;
+                os << "null";
+            }
+        }
+        os << ", \"truncated\": " << (truncated ? "true" : "false") << "}";
+    }
+    os << "\n]}\n";
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include "bst.h"
+#include "avlbst.h"
+#include "filterbst.h"
+
+using namespace std;
+
+// Lookups where 70% of the keys are missing: AVLTree::operator[] (which
+// throws on a miss), AVLTree::get, and FilteredAVLTree::get.
+//   usage: ./filter-bench [numKeys] [numLookups]
+
+template<typename Lookup>
+double timeLookups(Lookup lookup, const vector<uint64_t>& probes, size_t& hits)
+{
+    hits = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < probes.size(); i++)
+    {
+        if (lookup(probes[i])) hits++;
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(stop - start).count();
+}
+
+struct ThrowingLookup
+{
+    const AVLTree<uint64_t, uint64_t>* tree;
+    bool operator()(uint64_t key) const
+    {
+        try
+        {
+            (*tree)[key];
+            return true;
+        }
+        catch (const out_of_range&)
+        {
+            return false;
+        }
+    }
+};
+
+template<typename Tree>
+struct GetLookup
+{
+    const Tree* tree;
+    bool operator()(uint64_t key) const
+    {
+        return tree->get(key) != NULL;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    size_t numKeys = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t numLookups = argc > 2 ? atol(argv[2]) : 2000000;
+
+    // even keys are stored, odd keys miss
+    mt19937_64 rng(107);
+    vector<pair<uint64_t, uint64_t> > items(numKeys);
+    for (size_t i = 0; i < numKeys; i++) items[i] = make_pair((uint64_t)(rng() & ~1ULL), (uint64_t)i);
+    AVLTree<uint64_t, uint64_t> plain;
+    FilteredAVLTree<uint64_t, uint64_t> filtered;
+    plain.bulkBuild(items);
+    filtered.bulkBuild(items);
+
+    vector<uint64_t> probes(numLookups);
+    for (size_t i = 0; i < numLookups; i++)
+    {
+        probes[i] = (rng() % 10 < 3) ? items[rng() % numKeys].first : (rng() | 1);
+    }
+
+    ThrowingLookup throwing = { &plain };
+    GetLookup<AVLTree<uint64_t, uint64_t> > plainGet = { &plain };
+    GetLookup<FilteredAVLTree<uint64_t, uint64_t> > filteredGet = { &filtered };
+
+    size_t hits;
+    cout << "keys=" << numKeys << " lookups=" << numLookups << " (70% misses)" << endl;
+    cout << "AVLTree operator[]    : " << timeLookups(throwing, probes, hits) << " ms (" << hits << " hits)" << endl;
+    cout << "AVLTree get           : " << timeLookups(plainGet, probes, hits) << " ms (" << hits << " hits)" << endl;
+    cout << "FilteredAVLTree get   : " << timeLookups(filteredGet, probes, hits) << " ms (" << hits << " hits)" << endl;
+    return 0;
+}
@@ -0,0 +1,345 @@
+#ifndef FILTERBST_H
+#define FILTERBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "avlbst.h"
+
+// counters in one block; 64 one-byte counters fill one cache line
+#define BLOOM_BLOCK_COUNTERS 64
+// counters per expected key, ~1% false positives with BLOOM_PROBES probes
+#define BLOOM_COUNTERS_PER_KEY 12
+#define BLOOM_PROBES 4
+
+/**
+* A blocked counting Bloom filter. Each key maps to one block (one cache
+* line) and increments BLOOM_PROBES counters inside it, so a lookup costs
+* a single cache miss. Counters make removal possible; a counter that
+* saturates stays saturated, which can only cause false positives.
+*/
+template <typename Key>
+class CountingBloomFilter
+{
+public:
+    CountingBloomFilter(size_t expectedKeys = 0);
+
+    void add(const Key& key);
+    void remove(const Key& key);
+    bool mayContain(const Key& key) const;
+    void reset(size_t expectedKeys);
+    size_t capacity() const;
+
+protected:
+    uint64_t hashKey(const Key& key) const;
+
+protected:
+    std::vector<uint8_t> counters_;
+    size_t blocks_;
+};
+
+template<class Key>
+CountingBloomFilter<Key>::CountingBloomFilter(size_t expectedKeys) :
+    blocks_(0)
+{
+    reset(expectedKeys);
+}
+
+/**
+* Empties the filter and sizes it for expectedKeys keys.
+*/
+template<class Key>
+void CountingBloomFilter<Key>::reset(size_t expectedKeys)
+{
+    blocks_ = expectedKeys * BLOOM_COUNTERS_PER_KEY / BLOOM_BLOCK_COUNTERS + 1;
+    counters_.assign(blocks_ * BLOOM_BLOCK_COUNTERS, 0);
+}
+
+/**
+* Number of keys the filter was sized for.
+*/
+template<class Key>
+size_t CountingBloomFilter<Key>::capacity() const
+{
+    return blocks_ * BLOOM_BLOCK_COUNTERS / BLOOM_COUNTERS_PER_KEY;
+}
+
+template<class Key>
+void CountingBloomFilter<Key>::add(const Key& key)
+{
+    uint64_t hash = hashKey(key);
+    uint8_t* block = &counters_[(hash >> 32) % blocks_ * BLOOM_BLOCK_COUNTERS];
+    for (int i = 0; i < BLOOM_PROBES; i++)
+    {
+        uint8_t& counter = block[(hash >> (6 * i)) % BLOOM_BLOCK_COUNTERS];
+        if (counter != UINT8_MAX) counter++;
+    }
+}
+
+/**
+* @precondition key was added and not removed since
+*/
+template<class Key>
+void CountingBloomFilter<Key>::remove(const Key& key)
+{
+    uint64_t hash = hashKey(key);
+    uint8_t* block = &counters_[(hash >> 32) % blocks_ * BLOOM_BLOCK_COUNTERS];
+    for (int i = 0; i < BLOOM_PROBES; i++)
+    {
+        uint8_t& counter = block[(hash >> (6 * i)) % BLOOM_BLOCK_COUNTERS];
+        if (counter != UINT8_MAX && counter != 0) counter--;
+    }
+}
+
+/**
+* False means the key was definitely never added (or was removed).
+*/
+template<class Key>
+bool CountingBloomFilter<Key>::mayContain(const Key& key) const
+{
+    uint64_t hash = hashKey(key);
+    const uint8_t* block = &counters_[(hash >> 32) % blocks_ * BLOOM_BLOCK_COUNTERS];
+    for (int i = 0; i < BLOOM_PROBES; i++)
+    {
+        if (block[(hash >> (6 * i)) % BLOOM_BLOCK_COUNTERS] == 0) return false;
+    }
+    return true;
+}
+
+/*
+ * std::hash, with the bits mixed (splitmix64 finalizer) since std::hash
+ * of an integer is often the integer itself.
+ */
+template<class Key>
+uint64_t CountingBloomFilter<Key>::hashKey(const Key& key) const
+{
+    uint64_t hash = std::hash<Key>()(key);
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+/**
+* An AVLTree with a counting Bloom filter in front of its lookups. Keys
+* that were never inserted are usually rejected by the filter, without
+* descending the tree. The filter follows every node that is linked in or
+* unlinked (plain and hinted inserts, node handles, merge, range erase,
+* eraseIf, bulkBuild and clear) through AVLTree's virtual hooks, so it
+* stays exact however the tree is modified, including through a base
+* class reference. It grows with the tree. Key needs a std::hash
+* specialization.
+*/
+template <class Key, class Value>
+class FilteredAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename AVLTree<Key, Value>::iterator iterator;
+
+    FilteredAVLTree();
+    FilteredAVLTree(const FilteredAVLTree<Key, Value>& other);
+    FilteredAVLTree(FilteredAVLTree<Key, Value>&& other);
+    FilteredAVLTree<Key, Value>& operator=(const FilteredAVLTree<Key, Value>& other);
+    FilteredAVLTree<Key, Value>& operator=(FilteredAVLTree<Key, Value>&& other);
+
+    virtual void clear();
+    virtual void swap(BinarySearchTree<Key, Value>& other);
+
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+    bool contains(const Key& key) const;
+    Value* get(const Key& key);
+    const Value* get(const Key& key) const;
+
+protected:
+    virtual void unlinkNode(Node<Key, Value>* node);
+    virtual void nodeLinked(AVLNode<Key, Value>* node);
+    virtual void subtreeErased(AVLNode<Key, Value>* subtree);
+    virtual void afterStructureChange();
+
+    void rebuildFilter();
+
+protected:
+    CountingBloomFilter<Key> filter_;
+};
+
+template<class Key, class Value>
+FilteredAVLTree<Key, Value>::FilteredAVLTree() :
+    AVLTree<Key, Value>()
+{
+
+}
+
+template<class Key, class Value>
+FilteredAVLTree<Key, Value>::FilteredAVLTree(const FilteredAVLTree<Key, Value>& other) :
+    AVLTree<Key, Value>(other), filter_(other.filter_)
+{
+
+}
+
+/*
+ * other is left empty, with an empty filter to match.
+ */
+template<class Key, class Value>
+FilteredAVLTree<Key, Value>::FilteredAVLTree(FilteredAVLTree<Key, Value>&& other) :
+    AVLTree<Key, Value>(std::move(other)), filter_(std::move(other.filter_))
+{
+    other.filter_.reset(0);
+}
+
+/*
+ * The filters follow the new nodes through afterStructureChange().
+ */
+template<class Key, class Value>
+FilteredAVLTree<Key, Value>& FilteredAVLTree<Key, Value>::operator=(const FilteredAVLTree<Key, Value>& other)
+{
+    AVLTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+FilteredAVLTree<Key, Value>& FilteredAVLTree<Key, Value>::operator=(FilteredAVLTree<Key, Value>&& other)
+{
+    AVLTree<Key, Value>::operator=(std::move(other));
+    return *this;
+}
+
+template<class Key, class Value>
+void FilteredAVLTree<Key, Value>::clear()
+{
+    AVLTree<Key, Value>::clear();
+    filter_.reset(0);
+}
+
+/*
+ * Two filtered trees trade filters along with their nodes, in O(1).
+ * Against any other AVLTree the swap goes through the base class, and
+ * afterStructureChange() rebuilds this filter from its new nodes.
+ */
+template<class Key, class Value>
+void FilteredAVLTree<Key, Value>::swap(BinarySearchTree<Key, Value>& other)
+{
+    FilteredAVLTree<Key, Value>* filtered = dynamic_cast<FilteredAVLTree<Key, Value>*>(&other);
+    if (filtered == nullptr)
+    {
+        AVLTree<Key, Value>::swap(other);
+        return;
+    }
+    std::swap(this->root_, filtered->root_);
+    std::swap(this->size_, filtered->size_);
+    std::swap(this->rightmost_, filtered->rightmost_);
+    std::swap(filter_, filtered->filter_);
+}
+
+template<class Key, class Value>
+typename FilteredAVLTree<Key, Value>::iterator FilteredAVLTree<Key, Value>::find(const Key& key) const
+{
+    if (!filter_.mayContain(key)) return this->end();
+    return AVLTree<Key, Value>::find(key);
+}
+
+template<class Key, class Value>
+Value& FilteredAVLTree<Key, Value>::operator[](const Key& key)
+{
+    Value* value = get(key);
+    if (value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+template<class Key, class Value>
+Value const & FilteredAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    const Value* value = get(key);
+    if (value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+template<class Key, class Value>
+bool FilteredAVLTree<Key, Value>::contains(const Key& key) const
+{
+    return filter_.mayContain(key) && AVLTree<Key, Value>::contains(key);
+}
+
+template<class Key, class Value>
+Value* FilteredAVLTree<Key, Value>::get(const Key& key)
+{
+    if (!filter_.mayContain(key)) return nullptr;
+    return AVLTree<Key, Value>::get(key);
+}
+
+template<class Key, class Value>
+const Value* FilteredAVLTree<Key, Value>::get(const Key& key) const
+{
+    if (!filter_.mayContain(key)) return nullptr;
+    return AVLTree<Key, Value>::get(key);
+}
+
+/*
+ * Every node leaves through here: remove, erase, extract, merge and the
+ * per-node path of eraseIf.
+ */
+template<class Key, class Value>
+void FilteredAVLTree<Key, Value>::unlinkNode(Node<Key, Value>* node)
+{
+    filter_.remove(node->getKey());
+    AVLTree<Key, Value>::unlinkNode(node);
+}
+
+/*
+ * Every node that joins the tree on its own comes in through here:
+ * inserts, hinted inserts, node handles and merge. The filter grows once
+ * the tree outgrows it.
+ */
+template<class Key, class Value>
+void FilteredAVLTree<Key, Value>::nodeLinked(AVLNode<Key, Value>* node)
+{
+    if (this->size() > filter_.capacity()) rebuildFilter();
+    else filter_.add(node->getKey());
+}
+
+/*
+ * A range erase frees a whole detached subtree at once.
+ */
+template<class Key, class Value>
+void FilteredAVLTree<Key, Value>::subtreeErased(AVLNode<Key, Value>* subtree)
+{
+    std::vector<AVLNode<Key, Value>*> pending(1, subtree);
+    while (!pending.empty())
+    {
+        AVLNode<Key, Value>* current = pending.back();
+        pending.pop_back();
+        filter_.remove(current->getKey());
+        if (current->getLeft() != nullptr) pending.push_back(current->getLeft());
+        if (current->getRight() != nullptr) pending.push_back(current->getRight());
+    }
+}
+
+/*
+ * bulkBuild, the rebuild path of eraseIf and assignment replace the nodes
+ * wholesale; each is O(n) already.
+ */
+template<class Key, class Value>
+void FilteredAVLTree<Key, Value>::afterStructureChange()
+{
+    AVLTree<Key, Value>::afterStructureChange();
+    rebuildFilter();
+}
+
+/*
+ * Refills the filter from the tree, sized for twice the current size.
+ */
+template<class Key, class Value>
+void FilteredAVLTree<Key, Value>::rebuildFilter()
+{
+    filter_.reset(2 * this->size());
+    for (iterator it = this->begin(); it != this->end(); ++it) filter_.add(it->first);
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "bst.h"
+#include "avlbst.h"
+#include "fixedbst.h"
+
+using namespace std;
+
+// Lookups in a 256-entry table: a FixedAVLTree built at compile time
+// (embedded in the binary, no startup cost or heap), the same table built
+// at run time, and an AVLTree.
+//   usage: ./fixed-bench [numLookups]
+
+const size_t TABLE_SIZE = 256;
+typedef FixedAVLTree<uint32_t, uint32_t, TABLE_SIZE> Table;
+
+// key i * 2654435761 (scattered), value i
+constexpr Table makeTable()
+{
+    Table table;
+    for (uint32_t i = 0; i < TABLE_SIZE; i++) table.insert(make_pair(i * 2654435761u, i));
+    return table;
+}
+
+constexpr Table compiledTable = makeTable();
+static_assert(compiledTable.size() == TABLE_SIZE && compiledTable.isBalanced(), "table built at compile time");
+static_assert(compiledTable[7 * 2654435761u] == 7, "lookup at compile time");
+
+template<typename Lookup>
+double timeLookups(Lookup lookup, const vector<uint32_t>& probes, uint64_t& sum)
+{
+    sum = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < probes.size(); i++) sum += lookup(probes[i]);
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / probes.size();
+}
+
+struct FixedLookup
+{
+    const Table* table;
+    uint32_t operator()(uint32_t key) const { return *table->get(key); }
+};
+
+struct AVLLookup
+{
+    const AVLTree<uint32_t, uint32_t>* tree;
+    uint32_t operator()(uint32_t key) const { return *tree->get(key); }
+};
+
+int main(int argc, char *argv[])
+{
+    size_t numLookups = argc > 1 ? atol(argv[1]) : 10000000;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Table runtimeTable = makeTable();
+    double fixedBuildUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    AVLTree<uint32_t, uint32_t> tree;
+    for (uint32_t i = 0; i < TABLE_SIZE; i++) tree.insert(make_pair(i * 2654435761u, i));
+    double avlBuildUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+    mt19937 rng(108);
+    vector<uint32_t> probes(numLookups);
+    for (size_t i = 0; i < numLookups; i++) probes[i] = (uint32_t)(rng() % TABLE_SIZE) * 2654435761u;
+
+    uint64_t compiledSum, runtimeSum, avlSum;
+    FixedLookup compiled = { &compiledTable };
+    FixedLookup runtime = { &runtimeTable };
+    AVLLookup avl = { &tree };
+    double compiledNs = timeLookups(compiled, probes, compiledSum);
+    double runtimeNs = timeLookups(runtime, probes, runtimeSum);
+    double avlNs = timeLookups(avl, probes, avlSum);
+
+    cout << "table=" << TABLE_SIZE << " lookups=" << numLookups << endl;
+    cout << "FixedAVLTree, compile time: build 0 us, " << sizeof(Table) << " bytes, "
+         << compiledNs << " ns/lookup" << endl;
+    cout << "FixedAVLTree, run time    : build " << fixedBuildUs << " us, " << sizeof(Table) << " bytes, "
+         << runtimeNs << " ns/lookup" << endl;
+    cout << "AVLTree                   : build " << avlBuildUs << " us, " << tree.memoryUsage().totalBytes()
+         << " bytes, " << avlNs << " ns/lookup" << endl;
+    if (compiledSum != runtimeSum || compiledSum != avlSum)
+    {
+        cerr << "lookup mismatch: compiled " << compiledSum << ", run time " << runtimeSum << ", AVLTree " << avlSum
+             << endl;
+        return 1;
+    }
+    return 0;
+}
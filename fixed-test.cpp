@@ -0,0 +1,142 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include "fixedbst.h"
+
+using namespace std;
+
+// Removes from FixedAVLTree, at compile time and at run time. Kept apart
+// from bst-test because fixedbst.h needs C++20.
+
+static int failures = 0;
+
+static void check(bool ok, const char* msg)
+{
+    cout << msg << ": " << (ok ? "pass" : "FAIL") << endl;
+    if (!ok) failures++;
+}
+
+// exposes the free list, to see which slot an insert reuses
+template<size_t N>
+struct SlotProbe : public FixedAVLTree<int, int, N>
+{
+    constexpr auto nextFree() const { return this->free_; }
+    constexpr auto slotOf(int key) const
+    {
+        auto current = this->root_;
+        while (this->slots_[current].item.first != key)
+        {
+            current = key < this->slots_[current].item.first ? this->slots_[current].left : this->slots_[current].right;
+        }
+        return current;
+    }
+};
+
+// tree holds exactly the items of expected, in order, and is balanced
+template<size_t N>
+constexpr bool matches(const FixedAVLTree<int, int, N>& tree, const int* keys, size_t count)
+{
+    if (tree.size() != count || !tree.isBalanced()) return false;
+    size_t i = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++i)
+    {
+        if (i == count || it->first != keys[i] || it->second != keys[i] * 10) return false;
+    }
+    return i == count;
+}
+
+// Fills an 8-slot tree with 1..8, then removes the root (two children),
+// a leaf and a node with one child. The freed slots are the ones the
+// next inserts take, and the tree fills back up to capacity.
+constexpr bool removeAtCompileTime()
+{
+    SlotProbe<8> tree;
+    for (int key = 1; key <= 8; key++) tree.insert(std::make_pair(key, key * 10));
+    const int full[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    if (!matches(tree, full, 8) || tree.nextFree() != SlotProbe<8>::NIL) return false;
+
+    // 4 is the root; its predecessor 3 moves up and 3's slot is freed
+    auto predecessorSlot = tree.slotOf(3);
+    tree.remove(4);
+    const int noRoot[] = { 1, 2, 3, 5, 6, 7, 8 };
+    if (!matches(tree, noRoot, 7) || tree.nextFree() != predecessorSlot) return false;
+
+    tree.remove(8);
+    tree.remove(7);
+    tree.remove(42);
+    const int fewer[] = { 1, 2, 3, 5, 6 };
+    if (!matches(tree, fewer, 5)) return false;
+
+    auto reused = tree.nextFree();
+    tree.insert(std::make_pair(9, 90));
+    if (tree.slotOf(9) != reused) return false;
+    tree.insert(std::make_pair(4, 40));
+    tree.insert(std::make_pair(0, 0));
+    const int refilled[] = { 0, 1, 2, 3, 4, 5, 6, 9 };
+    if (!matches(tree, refilled, 8) || tree.nextFree() != SlotProbe<8>::NIL) return false;
+
+    for (int key = 0; key <= 9; key++) tree.remove(key);
+    return tree.empty() && tree.begin() == tree.end() && tree.isBalanced();
+}
+
+static_assert(removeAtCompileTime(), "remove and slot reuse at compile time");
+
+// Random inserts and removes against std::map, filling the tree to
+// capacity over and over; a new key in a full tree throws and changes nothing.
+void testRandomUpdates(const char* msg)
+{
+    const size_t N = 64;
+    SlotProbe<N> tree;
+    map<int, int> expected;
+    mt19937 rng(47);
+    bool ok = true;
+    int rejected = 0;
+    for (int i = 0; i < 20000 && ok; i++)
+    {
+        int key = (int)(rng() % 100);
+        if (rng() % 3 == 0)
+        {
+            tree.remove(key);
+            expected.erase(key);
+        }
+        else if (expected.size() == N && expected.count(key) == 0)
+        {
+            try
+            {
+                tree.insert(make_pair(key, i));
+                ok = false;
+            }
+            catch (const std::length_error&)
+            {
+                rejected++;
+            }
+        }
+        else
+        {
+            bool reuses = expected.count(key) == 0;
+            auto slot = tree.nextFree();
+            tree.insert(make_pair(key, i));
+            expected[key] = i;
+            ok = !reuses || tree.slotOf(key) == slot;
+        }
+
+        ok = ok && tree.size() == expected.size() && tree.isBalanced();
+        auto it = tree.begin();
+        for (map<int, int>::const_iterator e = expected.begin(); ok && e != expected.end(); ++e, ++it)
+        {
+            ok = it != tree.end() && it->first == e->first && it->second == e->second;
+        }
+        ok = ok && it == tree.end();
+    }
+    check(ok && rejected > 0, msg);
+}
+
+int main()
+{
+    check(true, "remove and slot reuse at compile time");
+    testRandomUpdates("random inserts and removes against std::map");
+
+    cout << (failures == 0 ? "all tests passed" : "some tests FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
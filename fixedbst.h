@@ -0,0 +1,323 @@
+#ifndef FIXEDBST_H
+#define FIXEDBST_H
+
+#if __cplusplus < 202002L
+#error "fixedbst.h needs C++20 (-std=c++20)"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <initializer_list>
+#include <type_traits>
+#include "indexedavl.h"
+
+/**
+* An AVL map with room for at most N items and no heap allocation. Nodes
+* live in an array inside the tree and link to each other by index; free
+* slots are kept on a list threaded through the same links. Insert and
+* remove rebalance with IndexedAVL (indexedavl.h), exactly like AVLTree,
+* so the shape matches an AVLTree fed the same operations.
+*
+* Everything is constexpr, so a table can be built at compile time:
+*
+*   constexpr FixedAVLTree<int, int, 8> table = { {1, 10}, {2, 20} };
+*   static_assert(table[2] == 20);
+*
+* Key and Value must be default-constructible (and literal types for
+* constexpr use). Inserting into a full tree throws std::length_error,
+* which in a constant expression is a compile error. Iterators are
+* read-only and invalidated by insert and remove.
+*/
+template <class Key, class Value, size_t N>
+class FixedAVLTree
+{
+public:
+    typedef typename std::conditional<(N < 0xffff), uint16_t, uint32_t>::type Index;
+    static constexpr Index NIL = (Index)-1;
+
+    class iterator
+    {
+    public:
+        constexpr iterator() : tree_(nullptr), index_(NIL) { }
+
+        constexpr const std::pair<Key, Value>& operator*() const { return tree_->slots_[index_].item; }
+        constexpr const std::pair<Key, Value>* operator->() const { return &tree_->slots_[index_].item; }
+        constexpr bool operator==(const iterator& rhs) const { return index_ == rhs.index_; }
+        constexpr bool operator!=(const iterator& rhs) const { return index_ != rhs.index_; }
+        constexpr iterator& operator++()
+        {
+            index_ = tree_->successor(index_);
+            return *this;
+        }
+
+    protected:
+        friend class FixedAVLTree<Key, Value, N>;
+        constexpr iterator(const FixedAVLTree<Key, Value, N>* tree, Index index) : tree_(tree), index_(index) { }
+
+        const FixedAVLTree<Key, Value, N>* tree_;
+        Index index_;
+    };
+
+    constexpr FixedAVLTree();
+    constexpr FixedAVLTree(std::initializer_list<std::pair<Key, Value> > items);
+
+    constexpr void insert(const std::pair<const Key, Value>& new_item);
+    constexpr void remove(const Key& key);
+    constexpr void clear();
+
+    constexpr iterator begin() const;
+    constexpr iterator end() const;
+    constexpr iterator find(const Key& key) const;
+    constexpr bool contains(const Key& key) const;
+    constexpr Value* get(const Key& key);
+    constexpr const Value* get(const Key& key) const;
+    constexpr Value const & operator[](const Key& key) const;
+
+    constexpr size_t size() const;
+    constexpr bool empty() const;
+    static constexpr size_t capacity() { return N; }
+    constexpr bool isBalanced() const;
+
+protected:
+    struct Slot
+    {
+        std::pair<Key, Value> item {};
+        Index left = NIL;
+        Index right = NIL; // next free slot while on the free list
+        Index parent = NIL;
+        int8_t balance = 0;
+    };
+
+    typedef IndexedAVL<Slot, Index, NIL> Rebalance;
+
+    constexpr Index internalFind(const Key& key) const;
+    constexpr Index successor(Index current) const;
+    constexpr Index allocate(const std::pair<const Key, Value>& item, Index parent);
+    constexpr void release(Index index);
+
+protected:
+    Slot slots_[N];
+    Index root_;
+    Index free_;
+    size_t size_;
+};
+
+template<class Key, class Value, size_t N>
+constexpr FixedAVLTree<Key, Value, N>::FixedAVLTree() :
+    slots_(), root_(NIL), free_(NIL), size_(0)
+{
+    static_assert(N > 0 && N < (size_t)NIL, "FixedAVLTree capacity out of range");
+    clear();
+}
+
+template<class Key, class Value, size_t N>
+constexpr FixedAVLTree<Key, Value, N>::FixedAVLTree(std::initializer_list<std::pair<Key, Value> > items) :
+    FixedAVLTree()
+{
+    for (const std::pair<Key, Value>& item : items) insert(item);
+}
+
+/**
+* Inserts new_item, overwriting the value if the key is already present.
+* Throws std::length_error if the key is new and the tree is full.
+*/
+template<class Key, class Value, size_t N>
+constexpr void FixedAVLTree<Key, Value, N>::insert(const std::pair<const Key, Value>& new_item)
+{
+    if (root_ == NIL)
+    {
+        root_ = allocate(new_item, NIL);
+        return;
+    }
+
+    Index parent = root_;
+    while (true)
+    {
+        Slot& current = slots_[parent];
+        if (current.item.first == new_item.first)
+        {
+            current.item.second = new_item.second;
+            return;
+        }
+        Index next = new_item.first < current.item.first ? current.left : current.right;
+        if (next == NIL) break;
+        parent = next;
+    }
+
+    Index newNode = allocate(new_item, parent);
+    Rebalance(slots_, root_).attachLeaf(parent, newNode, new_item.first < slots_[parent].item.first);
+}
+
+/**
+* Removes key if present. A node with two children takes over its
+* predecessor's item, and the predecessor's slot is the one freed.
+*/
+template<class Key, class Value, size_t N>
+constexpr void FixedAVLTree<Key, Value, N>::remove(const Key& key)
+{
+    Index nodeToRemove = internalFind(key);
+    if (nodeToRemove == NIL) return;
+
+    if (slots_[nodeToRemove].left != NIL && slots_[nodeToRemove].right != NIL)
+    {
+        Index predecessor = slots_[nodeToRemove].left;
+        while (slots_[predecessor].right != NIL) predecessor = slots_[predecessor].right;
+        slots_[nodeToRemove].item = slots_[predecessor].item;
+        nodeToRemove = predecessor;
+    }
+
+    Rebalance(slots_, root_).detach(nodeToRemove);
+    release(nodeToRemove);
+}
+
+/**
+* Removes every item and puts all slots back on the free list.
+*/
+template<class Key, class Value, size_t N>
+constexpr void FixedAVLTree<Key, Value, N>::clear()
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        slots_[i] = Slot();
+        slots_[i].right = i + 1 < N ? (Index)(i + 1) : NIL;
+    }
+    root_ = NIL;
+    free_ = 0;
+    size_ = 0;
+}
+
+template<class Key, class Value, size_t N>
+constexpr typename FixedAVLTree<Key, Value, N>::iterator FixedAVLTree<Key, Value, N>::begin() const
+{
+    Index current = root_;
+    while (current != NIL && slots_[current].left != NIL) current = slots_[current].left;
+    return iterator(this, current);
+}
+
+template<class Key, class Value, size_t N>
+constexpr typename FixedAVLTree<Key, Value, N>::iterator FixedAVLTree<Key, Value, N>::end() const
+{
+    return iterator(this, NIL);
+}
+
+template<class Key, class Value, size_t N>
+constexpr typename FixedAVLTree<Key, Value, N>::iterator FixedAVLTree<Key, Value, N>::find(const Key& key) const
+{
+    return iterator(this, internalFind(key));
+}
+
+template<class Key, class Value, size_t N>
+constexpr bool FixedAVLTree<Key, Value, N>::contains(const Key& key) const
+{
+    return internalFind(key) != NIL;
+}
+
+/**
+* Returns a pointer to the value for key, or NULL if it is not present.
+*/
+template<class Key, class Value, size_t N>
+constexpr Value* FixedAVLTree<Key, Value, N>::get(const Key& key)
+{
+    Index found = internalFind(key);
+    return found == NIL ? nullptr : &slots_[found].item.second;
+}
+
+template<class Key, class Value, size_t N>
+constexpr const Value* FixedAVLTree<Key, Value, N>::get(const Key& key) const
+{
+    Index found = internalFind(key);
+    return found == NIL ? nullptr : &slots_[found].item.second;
+}
+
+template<class Key, class Value, size_t N>
+constexpr Value const & FixedAVLTree<Key, Value, N>::operator[](const Key& key) const
+{
+    Index found = internalFind(key);
+    if (found == NIL) throw std::out_of_range("Invalid key");
+    return slots_[found].item.second;
+}
+
+template<class Key, class Value, size_t N>
+constexpr size_t FixedAVLTree<Key, Value, N>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, size_t N>
+constexpr bool FixedAVLTree<Key, Value, N>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Return true iff every node's subtrees differ in height by at most one
+* and its balance factor says so.
+*/
+template<class Key, class Value, size_t N>
+constexpr bool FixedAVLTree<Key, Value, N>::isBalanced() const
+{
+    return Rebalance::checkHeight(slots_, root_) != -1;
+}
+
+template<class Key, class Value, size_t N>
+constexpr typename FixedAVLTree<Key, Value, N>::Index FixedAVLTree<Key, Value, N>::internalFind(const Key& key) const
+{
+    Index current = root_;
+    while (current != NIL)
+    {
+        if (slots_[current].item.first == key) return current;
+        current = key < slots_[current].item.first ? slots_[current].left : slots_[current].right;
+    }
+    return NIL;
+}
+
+template<class Key, class Value, size_t N>
+constexpr typename FixedAVLTree<Key, Value, N>::Index FixedAVLTree<Key, Value, N>::successor(Index current) const
+{
+    if (slots_[current].right != NIL)
+    {
+        current = slots_[current].right;
+        while (slots_[current].left != NIL) current = slots_[current].left;
+        return current;
+    }
+    Index parent = slots_[current].parent;
+    while (parent != NIL && slots_[parent].right == current)
+    {
+        current = parent;
+        parent = slots_[parent].parent;
+    }
+    return parent;
+}
+
+/*
+ * Takes a slot off the free list for a new leaf.
+ */
+template<class Key, class Value, size_t N>
+constexpr typename FixedAVLTree<Key, Value, N>::Index
+FixedAVLTree<Key, Value, N>::allocate(const std::pair<const Key, Value>& item, Index parent)
+{
+    if (free_ == NIL) throw std::length_error("FixedAVLTree is full");
+    Index index = free_;
+    free_ = slots_[index].right;
+    slots_[index].item.first = item.first;
+    slots_[index].item.second = item.second;
+    slots_[index].left = NIL;
+    slots_[index].right = NIL;
+    slots_[index].parent = parent;
+    slots_[index].balance = 0;
+    size_++;
+    return index;
+}
+
+template<class Key, class Value, size_t N>
+constexpr void FixedAVLTree<Key, Value, N>::release(Index index)
+{
+    slots_[index] = Slot();
+    slots_[index].right = free_;
+    free_ = index;
+    size_--;
+}
+
+#endif
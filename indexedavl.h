@@ -0,0 +1,268 @@
+#ifndef INDEXEDAVL_H
+#define INDEXEDAVL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// constexpr where the language allows mutation in constant expressions,
+// so FixedAVLTree (C++20) can rebalance at compile time while
+// PooledAVLTree still builds as C++11
+#if __cplusplus >= 201402L
+#define INDEXED_AVL_CONSTEXPR constexpr
+#else
+#define INDEXED_AVL_CONSTEXPR
+#endif
+
+/**
+* AVL rebalancing for trees whose nodes live in an array and link to each
+* other by index (FixedAVLTree, PooledAVLTree). Slot is the array element
+* and must have left, right and parent links of type Index and an int8_t
+* balance factor (right height minus left height); nil marks a missing
+* link. The helper only holds the array and the tree's root, so trees
+* make one on the spot for each update:
+*
+*   IndexedAVL<Slot, Index, NIL>(slots_, root_).attachLeaf(parent, leaf, asLeft);
+*
+* The fixes and rotations are the same as AVLTree's, so the shapes match
+* an AVLTree fed the same operations.
+*/
+template <class Slot, class Index, Index nil>
+class IndexedAVL
+{
+public:
+    INDEXED_AVL_CONSTEXPR IndexedAVL(Slot* slots, Index& root) : slots_(slots), root_(root) { }
+
+    INDEXED_AVL_CONSTEXPR void attachLeaf(Index parent, Index leaf, bool asLeft);
+    INDEXED_AVL_CONSTEXPR void detach(Index thisNode);
+    static INDEXED_AVL_CONSTEXPR int checkHeight(const Slot* slots, Index thisNode);
+
+protected:
+    INDEXED_AVL_CONSTEXPR void replaceChild(Index parent, Index oldChild, Index newChild);
+    INDEXED_AVL_CONSTEXPR void insertFix(Index parent, Index thisNode);
+    INDEXED_AVL_CONSTEXPR void removeFix(Index parent, int8_t diff);
+    INDEXED_AVL_CONSTEXPR void rotateLeft(Index grandParent);
+    INDEXED_AVL_CONSTEXPR void rotateRight(Index grandParent);
+
+protected:
+    Slot* slots_;
+    Index& root_;
+};
+
+/**
+* Links the new leaf under parent (or makes it the root if parent is nil)
+* and rebalances. The leaf's own links must already be set.
+*/
+template<class Slot, class Index, Index nil>
+INDEXED_AVL_CONSTEXPR void IndexedAVL<Slot, Index, nil>::attachLeaf(Index parent, Index leaf, bool asLeft)
+{
+    if (parent == nil)
+    {
+        root_ = leaf;
+        return;
+    }
+    if (asLeft) slots_[parent].left = leaf;
+    else slots_[parent].right = leaf;
+
+    int8_t parentBalance = slots_[parent].balance;
+    slots_[parent].balance += asLeft ? -1 : 1;
+    if (parentBalance == 1 || parentBalance == -1)
+    {
+        slots_[parent].balance = 0;
+        return;
+    }
+    insertFix(parent, leaf);
+}
+
+/**
+* Unlinks a node with at most one child, moving the child up, and
+* rebalances. The node's slot is left for the tree to free.
+*/
+template<class Slot, class Index, Index nil>
+INDEXED_AVL_CONSTEXPR void IndexedAVL<Slot, Index, nil>::detach(Index thisNode)
+{
+    Index parent = slots_[thisNode].parent;
+    int8_t diff = 0;
+    if (parent != nil) diff = slots_[parent].left == thisNode ? 1 : -1;
+
+    Index child = slots_[thisNode].left != nil ? slots_[thisNode].left : slots_[thisNode].right;
+    if (child != nil) slots_[child].parent = parent;
+    replaceChild(parent, thisNode, child);
+    removeFix(parent, diff);
+}
+
+/**
+* Height of the subtree at thisNode in slots, or -1 if some node in it is
+* out of balance or has a wrong balance factor. Static, so const trees
+* can call it.
+*/
+template<class Slot, class Index, Index nil>
+INDEXED_AVL_CONSTEXPR int IndexedAVL<Slot, Index, nil>::checkHeight(const Slot* slots, Index thisNode)
+{
+    if (thisNode == nil) return 0;
+    int leftHeight = checkHeight(slots, slots[thisNode].left);
+    int rightHeight = checkHeight(slots, slots[thisNode].right);
+    if (leftHeight == -1 || rightHeight == -1) return -1;
+    if (rightHeight - leftHeight != slots[thisNode].balance) return -1;
+    if (rightHeight - leftHeight > 1 || leftHeight - rightHeight > 1) return -1;
+    return 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+}
+
+/*
+ * Points parent's link to oldChild (or the root, if parent is nil) at newChild.
+ */
+template<class Slot, class Index, Index nil>
+INDEXED_AVL_CONSTEXPR void IndexedAVL<Slot, Index, nil>::replaceChild(Index parent, Index oldChild, Index newChild)
+{
+    if (parent == nil) root_ = newChild;
+    else if (slots_[parent].left == oldChild) slots_[parent].left = newChild;
+    else slots_[parent].right = newChild;
+}
+
+template<class Slot, class Index, Index nil>
+INDEXED_AVL_CONSTEXPR void IndexedAVL<Slot, Index, nil>::insertFix(Index parent, Index thisNode)
+{
+    if (parent == nil) return;
+    Index grandParent = slots_[parent].parent;
+    if (grandParent == nil) return;
+
+    if (slots_[grandParent].left == parent)
+    {
+        slots_[grandParent].balance -= 1;
+        if (slots_[grandParent].balance == 0) return;
+        if (slots_[grandParent].balance == -1)
+        {
+            insertFix(grandParent, parent);
+            return;
+        }
+        if (slots_[parent].left == thisNode)
+        {
+            rotateRight(grandParent);
+            slots_[grandParent].balance = 0;
+            slots_[parent].balance = 0;
+            return;
+        }
+        rotateLeft(parent);
+        rotateRight(grandParent);
+        int8_t balance = slots_[thisNode].balance;
+        slots_[parent].balance = balance == 1 ? -1 : 0;
+        slots_[grandParent].balance = balance == -1 ? 1 : 0;
+        slots_[thisNode].balance = 0;
+    }
+    else
+    {
+        slots_[grandParent].balance += 1;
+        if (slots_[grandParent].balance == 0) return;
+        if (slots_[grandParent].balance == 1)
+        {
+            insertFix(grandParent, parent);
+            return;
+        }
+        if (slots_[parent].right == thisNode)
+        {
+            rotateLeft(grandParent);
+            slots_[grandParent].balance = 0;
+            slots_[parent].balance = 0;
+            return;
+        }
+        rotateRight(parent);
+        rotateLeft(grandParent);
+        int8_t balance = slots_[thisNode].balance;
+        slots_[parent].balance = balance == -1 ? 1 : 0;
+        slots_[grandParent].balance = balance == 1 ? -1 : 0;
+        slots_[thisNode].balance = 0;
+    }
+}
+
+/*
+ * parent's subtree on one side got shorter: diff is +1 if it was the
+ * left side, -1 if the right.
+ */
+template<class Slot, class Index, Index nil>
+INDEXED_AVL_CONSTEXPR void IndexedAVL<Slot, Index, nil>::removeFix(Index parent, int8_t diff)
+{
+    if (parent == nil) return;
+
+    Index nextParent = slots_[parent].parent;
+    int8_t ndiff = 0;
+    if (nextParent != nil) ndiff = slots_[nextParent].left == parent ? 1 : -1;
+
+    int balance = slots_[parent].balance + diff;
+    if (balance == 0)
+    {
+        slots_[parent].balance = 0;
+        removeFix(nextParent, ndiff);
+        return;
+    }
+    if (balance == 1 || balance == -1)
+    {
+        slots_[parent].balance = (int8_t)balance;
+        return;
+    }
+
+    // balance is +-2: rotate the taller child up
+    Index tallerChild = balance == -2 ? slots_[parent].left : slots_[parent].right;
+    int8_t side = balance == -2 ? -1 : 1;
+    int8_t childBalance = slots_[tallerChild].balance;
+    if (childBalance == side)
+    {
+        if (side == -1) rotateRight(parent);
+        else rotateLeft(parent);
+        slots_[parent].balance = 0;
+        slots_[tallerChild].balance = 0;
+        removeFix(nextParent, ndiff);
+    }
+    else if (childBalance == 0)
+    {
+        if (side == -1) rotateRight(parent);
+        else rotateLeft(parent);
+        slots_[parent].balance = side;
+        slots_[tallerChild].balance = (int8_t)-side;
+    }
+    else
+    {
+        Index grandChild = side == -1 ? slots_[tallerChild].right : slots_[tallerChild].left;
+        int8_t grandBalance = slots_[grandChild].balance;
+        if (side == -1)
+        {
+            rotateLeft(tallerChild);
+            rotateRight(parent);
+        }
+        else
+        {
+            rotateRight(tallerChild);
+            rotateLeft(parent);
+        }
+        slots_[parent].balance = grandBalance == side ? (int8_t)-side : 0;
+        slots_[tallerChild].balance = grandBalance == -side ? side : 0;
+        slots_[grandChild].balance = 0;
+        removeFix(nextParent, ndiff);
+    }
+}
+
+template<class Slot, class Index, Index nil>
+INDEXED_AVL_CONSTEXPR void IndexedAVL<Slot, Index, nil>::rotateLeft(Index grandParent)
+{
+    Index parent = slots_[grandParent].right;
+    Index parentOriginalLeft = slots_[parent].left;
+    slots_[parent].left = grandParent;
+    slots_[grandParent].right = parentOriginalLeft;
+    if (parentOriginalLeft != nil) slots_[parentOriginalLeft].parent = grandParent;
+    slots_[parent].parent = slots_[grandParent].parent;
+    replaceChild(slots_[grandParent].parent, grandParent, parent);
+    slots_[grandParent].parent = parent;
+}
+
+template<class Slot, class Index, Index nil>
+INDEXED_AVL_CONSTEXPR void IndexedAVL<Slot, Index, nil>::rotateRight(Index grandParent)
+{
+    Index parent = slots_[grandParent].left;
+    Index parentOriginalRight = slots_[parent].right;
+    slots_[parent].right = grandParent;
+    slots_[grandParent].left = parentOriginalRight;
+    if (parentOriginalRight != nil) slots_[parentOriginalRight].parent = grandParent;
+    slots_[parent].parent = slots_[grandParent].parent;
+    replaceChild(slots_[grandParent].parent, grandParent, parent);
+    slots_[grandParent].parent = parent;
+}
+
+#endif
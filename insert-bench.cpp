@@ -0,0 +1,72 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Compares AVLTree insertion cost for sorted, nearly sorted and random input,
+// with plain insert and with hinted insert (feeding back the last iterator).
+//   usage: ./insert-bench [numKeys]
+
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+double timePlain(const vector<uint64_t>& keys)
+{
+    Tree tree;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(stop - start).count() / keys.size();
+}
+
+double timeHinted(const vector<uint64_t>& keys)
+{
+    Tree tree;
+    Tree::iterator hint = tree.end();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        hint = tree.insert(hint, make_pair(keys[i], keys[i]));
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(stop - start).count() / keys.size();
+}
+
+void report(const char* name, const vector<uint64_t>& keys)
+{
+    cout << name << ": insert " << timePlain(keys) << " ns/op, hinted insert "
+         << timeHinted(keys) << " ns/op" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t numKeys = argc > 1 ? atol(argv[1]) : 1000000;
+    mt19937_64 rng(104);
+
+    vector<uint64_t> sorted(numKeys);
+    for (size_t i = 0; i < numKeys; i++) sorted[i] = i;
+
+    // every key is at most a few positions away from its sorted slot
+    vector<uint64_t> nearlySorted = sorted;
+    for (size_t i = 0; i + 1 < numKeys; i++)
+    {
+        if (rng() % 8 == 0) swap(nearlySorted[i], nearlySorted[i + 1 + rng() % min<size_t>(4, numKeys - i - 1)]);
+    }
+
+    vector<uint64_t> shuffled = sorted;
+    shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    cout << "keys=" << numKeys << endl;
+    report("sorted       ", sorted);
+    report("nearly sorted", nearlySorted);
+    report("random       ", shuffled);
+    return 0;
+}
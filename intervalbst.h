@@ -0,0 +1,170 @@
+#ifndef INTERVALBST_H
+#define INTERVALBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include "augmentedbst.h"
+
+/**
+* The key of each interval: ordered by start, then by end.
+*/
+template <typename Point>
+struct IntervalKey
+{
+    IntervalKey() : start(), end() { }
+    IntervalKey(const Point& s, const Point& e) : start(s), end(e) { }
+
+    Point start;
+    Point end;
+};
+
+template <typename Point>
+bool operator<(const IntervalKey<Point>& lhs, const IntervalKey<Point>& rhs)
+{
+    return lhs.start < rhs.start || (!(rhs.start < lhs.start) && lhs.end < rhs.end);
+}
+
+template <typename Point>
+bool operator==(const IntervalKey<Point>& lhs, const IntervalKey<Point>& rhs)
+{
+    return !(lhs < rhs) && !(rhs < lhs);
+}
+
+template <typename Point>
+std::ostream& operator<<(std::ostream& os, const IntervalKey<Point>& interval)
+{
+    return os << "[" << interval.start << ", " << interval.end << "]";
+}
+
+/**
+* The value stored for each interval: its end point (again, for the
+* IntervalEndMax policy, which only sees values) and the user payload.
+*/
+template <typename Point, typename Value>
+struct IntervalValue
+{
+    IntervalValue() : end(), value() { }
+    IntervalValue(const Point& e, const Value& v) : end(e), value(v) { }
+
+    Point end;
+    Value value;
+};
+
+template <typename Point, typename Value>
+std::ostream& operator<<(std::ostream& os, const IntervalValue<Point, Value>& interval)
+{
+    return os << "end " << interval.end << ": " << interval.value;
+}
+
+/**
+* Augmentation policy for IntervalTree: the largest interval end point in
+* a subtree.
+*/
+template <typename Point, typename Value>
+struct IntervalEndMax
+{
+    typedef Point value_type;
+    static Point identity() { return std::numeric_limits<Point>::lowest(); }
+    static Point lift(const IntervalValue<Point, Value>& v) { return v.end; }
+    static Point combine(const Point& lhs, const Point& rhs) { return lhs < rhs ? rhs : lhs; }
+};
+
+/**
+* A map from closed intervals [start, end] to values. Items are keyed by
+* IntervalKey (start, end), so any number of intervals can share a start
+* point; inserting the same interval again replaces its value. Every node
+* tracks the largest end point in its subtree, so subtrees that cannot
+* contain an overlapping interval are skipped. A query reporting k
+* intervals takes O(min(n, (k + 1) log n)): each result can cost a
+* descent into a subtree whose largest end reaches the query but whose
+* other intervals do not.
+*
+* The value of each item is an IntervalValue. Items are added through
+* insert(start, end, value), which keeps the two copies of end in step.
+*/
+template <class Point, class Value>
+class IntervalTree : public AugmentedAVLTree<IntervalKey<Point>, IntervalValue<Point, Value>, IntervalEndMax<Point, Value> >
+{
+public:
+    typedef IntervalKey<Point> Interval;
+    typedef AugmentedAVLTree<Interval, IntervalValue<Point, Value>, IntervalEndMax<Point, Value> > Base;
+    typedef typename Base::iterator iterator;
+
+    void insert(const Point& start, const Point& end, const Value& value);
+    using Base::remove;
+    void remove(const Point& start, const Point& end);
+
+    void overlapping(const Point& lo, const Point& hi, std::vector<iterator>& results) const;
+    void stabbing(const Point& point, std::vector<iterator>& results) const;
+
+protected:
+    void collectOverlaps(const Point& lo, const Point& hi, std::vector<iterator>& results) const;
+};
+
+/**
+ * @precondition start <= end
+ */
+template<class Point, class Value>
+void IntervalTree<Point, Value>::insert(const Point& start, const Point& end, const Value& value)
+{
+    Base::insert(std::make_pair(Interval(start, end), IntervalValue<Point, Value>(end, value)));
+}
+
+template<class Point, class Value>
+void IntervalTree<Point, Value>::remove(const Point& start, const Point& end)
+{
+    Base::remove(Interval(start, end));
+}
+
+/**
+* Appends to results every interval that shares at least one point with
+* [lo, hi], in key order.
+*/
+template<class Point, class Value>
+void IntervalTree<Point, Value>::overlapping(const Point& lo, const Point& hi, std::vector<iterator>& results) const
+{
+    collectOverlaps(lo, hi, results);
+}
+
+/**
+* Appends to results every interval that contains point.
+*/
+template<class Point, class Value>
+void IntervalTree<Point, Value>::stabbing(const Point& point, std::vector<iterator>& results) const
+{
+    collectOverlaps(point, point, results);
+}
+
+/*
+ * In-order walk with an explicit stack, skipping every subtree whose
+ * largest end point is below lo and stopping at the first start past hi.
+ */
+template<class Point, class Value>
+void IntervalTree<Point, Value>::collectOverlaps(const Point& lo, const Point& hi, std::vector<iterator>& results) const
+{
+    std::vector<Node<Interval, IntervalValue<Point, Value> >*> pending;
+    Node<Interval, IntervalValue<Point, Value> >* current = this->root_;
+    while (true)
+    {
+        // no interval in a subtree whose largest end is below lo reaches lo
+        while (current != nullptr && !(Base::subtreeAggregate(current) < lo))
+        {
+            pending.push_back(current);
+            current = current->getLeft();
+        }
+        if (pending.empty()) return;
+        current = pending.back();
+        pending.pop_back();
+
+        // this interval and everything after it start after hi
+        if (hi < current->getKey().start) return;
+
+        if (!(current->getValue().end < lo)) results.push_back(this->makeIterator(current));
+        current = current->getRight();
+    }
+}
+
+#endif
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <thread>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Latency percentiles of AVLTree insert/find/remove/clear from the
+// BST_LATENCY histograms (this target is always built with it), with a
+// tree per thread: random inserts, finds, then removes that empty the tree.
+//   usage: ./latency-bench [numKeys] [threads]
+
+#ifndef BST_LATENCY
+#error "latency-bench needs -DBST_LATENCY"
+#endif
+
+static void workload(size_t numKeys, uint64_t seed)
+{
+    mt19937_64 rng(seed);
+    vector<uint64_t> keys(numKeys);
+    for (size_t i = 0; i < numKeys; i++) keys[i] = rng();
+
+    AVLTree<uint64_t, uint64_t> tree;
+    for (size_t i = 0; i < numKeys; i++) tree.insert(make_pair(keys[i], (uint64_t)i));
+    size_t hits = 0;
+    for (size_t i = 0; i < numKeys; i++) hits += tree.find(keys[rng() % numKeys]) != tree.end();
+    for (size_t i = 0; i < numKeys / 2; i++) tree.remove(keys[i]);
+    tree.clear();
+    if (hits != numKeys) cerr << "find missed keys" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t numKeys = argc > 1 ? atol(argv[1]) : 1000000;
+    unsigned threads = argc > 2 ? atoi(argv[2]) : 2;
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < threads; i++) workers.push_back(thread(workload, numKeys, 108 + i));
+    for (unsigned i = 0; i < threads; i++) workers[i].join();
+
+    cout << "keys=" << numKeys << " threads=" << threads << endl;
+    latencyReport(cout);
+    return 0;
+}
@@ -0,0 +1,372 @@
+#ifndef LATENCY_BST_H
+#define LATENCY_BST_H
+
+// BST latency recording
+//
+// Built with BST_LATENCY defined (make DEFS=-DBST_LATENCY), insert, remove,
+// find and clear of BinarySearchTree and AVLTree time themselves and add
+// the time to histograms kept per thread, so recording never takes a lock
+// or shares a cache line. Every operation is also filed under the number
+// of AVL rotations it did and the size of the tree, to tell apart slow
+// operations that rebalanced a lot from ones that hit a large tree.
+// latencySnapshot() adds up all threads and latencyReport() prints
+// percentiles. Without BST_LATENCY none of this is compiled in.
+//
+// Each recording thread keeps about 400 KB of histograms.
+
+#ifdef BST_LATENCY
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+enum LatencyOp { LATENCY_INSERT, LATENCY_REMOVE, LATENCY_FIND, LATENCY_CLEAR, LATENCY_OPS };
+
+// histogram precision: 2^LATENCY_SUB_BITS buckets per power of two (~6% error)
+#define LATENCY_SUB_BITS 4
+// latencies of 2^LATENCY_MAX_BITS ns (~18 minutes) and more share the last bucket
+#define LATENCY_MAX_BITS 40
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+// rotation classes 0, 1, 2, ..., and LATENCY_ROTATION_CLASSES - 1 or more
+#define LATENCY_ROTATION_CLASSES 4
+// size classes by powers of 4: [0, 4), [4, 16), ... up to 4^LATENCY_SIZE_CLASSES items
+#define LATENCY_SIZE_CLASSES 16
+
+/**
+* A histogram of latencies in nanoseconds with HDR-style log-linear
+* buckets: exact below 2^LATENCY_SUB_BITS, then 2^LATENCY_SUB_BITS
+* buckets per power of two. A thread records into its own histogram with
+* plain (relaxed) stores; other threads can read it at any time.
+*/
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram& other);
+    LatencyHistogram& operator=(const LatencyHistogram& other);
+
+    void record(uint64_t nanos);
+    void add(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t max() const;
+    double mean() const;
+    uint64_t percentile(double fraction) const;
+
+    static size_t bucketOf(uint64_t nanos);
+    static uint64_t bucketValue(size_t bucket);
+
+protected:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t amount);
+
+protected:
+    std::atomic<uint64_t> buckets_[LATENCY_BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> total_;
+    std::atomic<uint64_t> max_;
+};
+
+inline LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+inline LatencyHistogram::LatencyHistogram(const LatencyHistogram& other)
+{
+    reset();
+    add(other);
+}
+
+inline LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other)
+{
+    if (this != &other)
+    {
+        reset();
+        add(other);
+    }
+    return *this;
+}
+
+/*
+ * Only the owning thread writes, so a load and a store do instead of an
+ * atomic read-modify-write.
+ */
+inline void LatencyHistogram::bump(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void LatencyHistogram::record(uint64_t nanos)
+{
+    bump(buckets_[bucketOf(nanos)], 1);
+    bump(count_, 1);
+    bump(total_, nanos);
+    if (nanos > max_.load(std::memory_order_relaxed)) max_.store(nanos, std::memory_order_relaxed);
+}
+
+/**
+* Adds the counts of other to this histogram.
+*/
+inline void LatencyHistogram::add(const LatencyHistogram& other)
+{
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) bump(buckets_[i], other.buckets_[i].load(std::memory_order_relaxed));
+    bump(count_, other.count_.load(std::memory_order_relaxed));
+    bump(total_, other.total_.load(std::memory_order_relaxed));
+    uint64_t otherMax = other.max_.load(std::memory_order_relaxed);
+    if (otherMax > max_.load(std::memory_order_relaxed)) max_.store(otherMax, std::memory_order_relaxed);
+}
+
+inline void LatencyHistogram::reset()
+{
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) buckets_[i].store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    total_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+inline uint64_t LatencyHistogram::count() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+inline uint64_t LatencyHistogram::max() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+inline double LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n == 0 ? 0.0 : (double)total_.load(std::memory_order_relaxed) / n;
+}
+
+/**
+* The latency that fraction (0 to 1) of the recorded operations did not
+* exceed, to within one bucket. 0 if nothing was recorded.
+*/
+inline uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t rank = (uint64_t)(fraction * n);
+    if (rank >= n) rank = n - 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen > rank) return bucketValue(i) < max() ? bucketValue(i) : max();
+    }
+    return max();
+}
+
+inline size_t LatencyHistogram::bucketOf(uint64_t nanos)
+{
+    if (nanos < ((uint64_t)1 << LATENCY_SUB_BITS)) return (size_t)nanos;
+    if (nanos >= ((uint64_t)1 << LATENCY_MAX_BITS)) return LATENCY_BUCKETS - 1;
+    int exponent = 63 - __builtin_clzll(nanos);
+    size_t sub = (size_t)(nanos >> (exponent - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1);
+    return ((size_t)(exponent - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + sub;
+}
+
+/*
+ * The highest latency that falls in bucket.
+ */
+inline uint64_t LatencyHistogram::bucketValue(size_t bucket)
+{
+    if (bucket < ((size_t)1 << LATENCY_SUB_BITS)) return bucket;
+    int exponent = (int)(bucket >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+    uint64_t sub = bucket & ((1 << LATENCY_SUB_BITS) - 1);
+    uint64_t width = (uint64_t)1 << (exponent - LATENCY_SUB_BITS);
+    return (((uint64_t)1 << exponent) + sub * width) + width - 1;
+}
+
+/**
+* Everything recorded for one kind of operation.
+*/
+struct LatencyOpStats
+{
+    LatencyHistogram all;
+    LatencyHistogram byRotations[LATENCY_ROTATION_CLASSES];
+    LatencyHistogram bySize[LATENCY_SIZE_CLASSES]; // by floor(log4(tree size))
+
+    void add(const LatencyOpStats& other)
+    {
+        all.add(other.all);
+        for (size_t i = 0; i < LATENCY_ROTATION_CLASSES; i++) byRotations[i].add(other.byRotations[i]);
+        for (size_t i = 0; i < LATENCY_SIZE_CLASSES; i++) bySize[i].add(other.bySize[i]);
+    }
+
+    void reset()
+    {
+        all.reset();
+        for (size_t i = 0; i < LATENCY_ROTATION_CLASSES; i++) byRotations[i].reset();
+        for (size_t i = 0; i < LATENCY_SIZE_CLASSES; i++) bySize[i].reset();
+    }
+};
+
+/**
+* Result of latencySnapshot(): the recordings of every thread added up.
+*/
+struct LatencySnapshot
+{
+    LatencySnapshot() : ops(LATENCY_OPS) { }
+
+    std::vector<LatencyOpStats> ops; // indexed by LatencyOp
+};
+
+/*
+ * The recordings of every thread that has recorded anything. A thread's
+ * stats are kept after it exits, so they still show up in snapshots.
+ */
+struct LatencyRegistry
+{
+    std::mutex lock;
+    std::vector<LatencySnapshot*> threads;
+};
+
+inline LatencyRegistry& latencyRegistry()
+{
+    static LatencyRegistry registry;
+    return registry;
+}
+
+inline LatencySnapshot& threadLatencyStats()
+{
+    thread_local LatencySnapshot* stats = nullptr;
+    if (stats == nullptr)
+    {
+        stats = new LatencySnapshot();
+        LatencyRegistry& registry = latencyRegistry();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        registry.threads.push_back(stats);
+    }
+    return *stats;
+}
+
+// Rotations done by this thread, for LatencyScope to tell how many an operation did.
+inline uint64_t& threadLatencyRotations()
+{
+    thread_local uint64_t rotations = 0;
+    return rotations;
+}
+
+/**
+* The recordings of all threads so far, added up.
+*/
+inline LatencySnapshot latencySnapshot()
+{
+    LatencySnapshot snapshot;
+    LatencyRegistry& registry = latencyRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    for (size_t i = 0; i < registry.threads.size(); i++)
+    {
+        for (int op = 0; op < LATENCY_OPS; op++) snapshot.ops[op].add(registry.threads[i]->ops[op]);
+    }
+    return snapshot;
+}
+
+/**
+* Clears the recordings of all threads. Operations that finish while the
+* reset runs may be partly counted.
+*/
+inline void latencyReset()
+{
+    LatencyRegistry& registry = latencyRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    for (size_t i = 0; i < registry.threads.size(); i++)
+    {
+        for (int op = 0; op < LATENCY_OPS; op++) registry.threads[i]->ops[op].reset();
+    }
+}
+
+// Writes one line of percentiles for histogram.
+inline void latencyReportLine(std::ostream& os, const std::string& label, const LatencyHistogram& histogram)
+{
+    os << "  " << label;
+    for (size_t i = label.size(); i < 16; i++) os << ' ';
+    os << " count " << histogram.count() << "  mean " << (uint64_t)histogram.mean()
+       << "  p50 " << histogram.percentile(0.5) << "  p90 " << histogram.percentile(0.9)
+       << "  p99 " << histogram.percentile(0.99) << "  p99.9 " << histogram.percentile(0.999)
+       << "  max " << histogram.max() << '\n';
+}
+
+/**
+* Prints the latency percentiles (in ns) of each operation overall, by
+* rotations done and by tree size.
+*/
+inline void latencyReport(std::ostream& os, const LatencySnapshot& snapshot = latencySnapshot())
+{
+    static const char* opNames[] = { "insert", "remove", "find", "clear" };
+    for (int op = 0; op < LATENCY_OPS; op++)
+    {
+        const LatencyOpStats& stats = snapshot.ops[op];
+        if (stats.all.count() == 0) continue;
+        os << opNames[op] << " latency (ns)\n";
+        latencyReportLine(os, "all", stats.all);
+        // operations that never rotate (find, clear, non-AVL trees) only have the first class
+        for (size_t i = 0; i < LATENCY_ROTATION_CLASSES && stats.byRotations[0].count() != stats.all.count(); i++)
+        {
+            if (stats.byRotations[i].count() == 0) continue;
+            std::string label = std::to_string(i) + (i + 1 == LATENCY_ROTATION_CLASSES ? "+" : "") + " rotations";
+            latencyReportLine(os, label, stats.byRotations[i]);
+        }
+        for (size_t i = 0; i < LATENCY_SIZE_CLASSES; i++)
+        {
+            if (stats.bySize[i].count() == 0) continue;
+            latencyReportLine(os, "size < 4^" + std::to_string(i + 1), stats.bySize[i]);
+        }
+    }
+    os.flush();
+}
+
+/**
+* Times the enclosing operation and records it on destruction, under op,
+* the rotations done meanwhile and the tree size it started with.
+*/
+class LatencyScope
+{
+public:
+    LatencyScope(LatencyOp op, size_t size) :
+        op_(op), size_(size), rotations_(threadLatencyRotations()), start_(std::chrono::steady_clock::now())
+    {
+
+    }
+
+    ~LatencyScope()
+    {
+        uint64_t nanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+        uint64_t rotations = threadLatencyRotations() - rotations_;
+        size_t sizeClass = 0;
+        while (sizeClass + 1 < LATENCY_SIZE_CLASSES && (size_ >> (2 * (sizeClass + 1))) != 0) sizeClass++;
+
+        LatencyOpStats& stats = threadLatencyStats().ops[op_];
+        stats.all.record(nanos);
+        stats.byRotations[rotations < LATENCY_ROTATION_CLASSES ? rotations : LATENCY_ROTATION_CLASSES - 1].record(nanos);
+        stats.bySize[sizeClass].record(nanos);
+    }
+
+protected:
+    LatencyOp op_;
+    size_t size_;
+    uint64_t rotations_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// The hooks the trees call
+#define BST_LATENCY_SCOPE(op, size) LatencyScope latencyScope_(op, size)
+#define BST_LATENCY_ROTATION() (threadLatencyRotations()++)
+
+#else
+
+#define BST_LATENCY_SCOPE(op, size)
+#define BST_LATENCY_ROTATION()
+
+#endif
+
+#endif
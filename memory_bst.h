@@ -0,0 +1,138 @@
+#ifndef MEMORY_BST_H
+#define MEMORY_BST_H
+
+#include <string>
+#include <vector>
+
+// BST memory accounting
+//
+// memoryUsage() reports what a tree costs: the nodes themselves, what the
+// allocator adds on top of each node, and any heap memory owned by the
+// keys and values. Node counts are kept in O(1); only the heap memory of
+// keys/values needs a walk over the tree, and only for types that have a
+// HeapBytes hook.
+
+/**
+* Estimated bytes the allocator hands out for a request of size bytes:
+* a glibc-style malloc with an 8-byte chunk header, 16-byte alignment and
+* a 32-byte minimum chunk.
+*/
+inline size_t allocationBytes(size_t size)
+{
+    size_t chunk = (size + 8 + 15) & ~(size_t)15;
+    return chunk < 32 ? 32 : chunk;
+}
+
+/**
+* Hook for the heap memory owned by a key or value, beyond its own
+* sizeof. Specialize it for types that own memory:
+*
+*   template<> struct HeapBytes<MyType>
+*   {
+*       static const bool tracked = true;
+*       static size_t of(const MyType& item) { return ...; }
+*   };
+*
+* Types that are not tracked are assumed to own nothing and are not visited.
+*/
+template<typename T>
+struct HeapBytes
+{
+    static const bool tracked = false;
+    static size_t of(const T& item) { return 0; }
+};
+
+template<>
+struct HeapBytes<std::string>
+{
+    static const bool tracked = true;
+    static size_t of(const std::string& item)
+    {
+        // short strings live inside the string object itself
+        const char* self = reinterpret_cast<const char*>(&item);
+        if (item.data() >= self && item.data() < self + sizeof(item)) return 0;
+        return allocationBytes(item.capacity() + 1);
+    }
+};
+
+template<typename T>
+struct HeapBytes<std::vector<T> >
+{
+    static const bool tracked = true;
+    static size_t of(const std::vector<T>& item)
+    {
+        if (item.capacity() == 0) return 0;
+        size_t bytes = allocationBytes(item.capacity() * sizeof(T));
+        if (HeapBytes<T>::tracked)
+        {
+            for (size_t i = 0; i < item.size(); i++) bytes += HeapBytes<T>::of(item[i]);
+        }
+        return bytes;
+    }
+};
+
+/**
+* Result of BinarySearchTree::memoryUsage(). All sizes are in bytes.
+*/
+struct MemoryUsage
+{
+    size_t nodeCount;
+    size_t nodeBytes;      // sizeof(node) for every node
+    size_t allocatorSlack; // estimated allocator headers and rounding on top of nodeBytes
+    size_t payloadBytes;   // sizeof(std::pair<const Key, Value>) for every node
+    size_t heapBytes;      // memory owned by keys and values, per HeapBytes
+
+    size_t totalBytes() const
+    {
+        return nodeBytes + allocatorSlack + heapBytes;
+    }
+
+    // everything the tree costs per item
+    double bytesPerEntry() const
+    {
+        return nodeCount == 0 ? 0.0 : (double)totalBytes() / nodeCount;
+    }
+
+    // what each item costs beyond its key/value: links, balance, allocator
+    double overheadPerEntry() const
+    {
+        return nodeCount == 0 ? 0.0 : (double)(nodeBytes + allocatorSlack - payloadBytes) / nodeCount;
+    }
+};
+
+/**
+* Size of the node type the tree allocates. Trees with bigger nodes
+* override it.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::nodeBytes() const
+{
+    return sizeof(Node<Key, Value>);
+}
+
+/**
+* Reports the memory used by the tree. O(1) unless Key or Value has a
+* HeapBytes hook, in which case every item is visited once.
+*/
+template<typename Key, typename Value>
+MemoryUsage BinarySearchTree<Key, Value>::memoryUsage() const
+{
+    MemoryUsage usage;
+    size_t perNode = nodeBytes();
+    usage.nodeCount = size_;
+    usage.nodeBytes = perNode * size_;
+    usage.allocatorSlack = (allocationBytes(perNode) - perNode) * size_;
+    usage.payloadBytes = sizeof(std::pair<const Key, Value>) * size_;
+    usage.heapBytes = 0;
+
+    if (HeapBytes<Key>::tracked || HeapBytes<Value>::tracked)
+    {
+        for (iterator it = begin(); it != end(); ++it)
+        {
+            usage.heapBytes += HeapBytes<Key>::of(it->first) + HeapBytes<Value>::of(it->second);
+        }
+    }
+    return usage;
+}
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef PARALLEL_BST_H
+#define PARALLEL_BST_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+// Parallel traversal over a BST
+//
+// The top levels of the tree are cut into an in-order list of pieces: each
+// piece is either a single node or a whole subtree below the cut. Threads
+// repeatedly claim the next unclaimed piece from a shared counter, so a
+// thread that finishes a small subtree early just takes more work. Each
+// subtree is walked iteratively in key order.
+
+// pieces to cut per thread, so uneven subtrees still balance out
+#define PARALLEL_PIECES_PER_THREAD 8
+
+template<typename Key, typename Value>
+struct TraversalPiece
+{
+    Node<Key, Value>* node;
+    bool wholeSubtree;
+};
+
+/**
+* Appends the pieces for the subtree at thisNode, in key order. levels is
+* how many more levels to cut before taking whole subtrees.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::cutSubtree(Node<Key, Value>* thisNode, int levels,
+                                              std::vector<TraversalPiece<Key, Value> >& pieces)
+{
+    if (thisNode == nullptr) return;
+    if (levels == 0)
+    {
+        TraversalPiece<Key, Value> piece = { thisNode, true };
+        pieces.push_back(piece);
+        return;
+    }
+    cutSubtree(thisNode->getLeft(), levels - 1, pieces);
+    TraversalPiece<Key, Value> piece = { thisNode, false };
+    pieces.push_back(piece);
+    cutSubtree(thisNode->getRight(), levels - 1, pieces);
+}
+
+/**
+* Cuts the tree into enough pieces to keep threads busy.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::cutPieces(unsigned threads, std::vector<TraversalPiece<Key, Value> >& pieces) const
+{
+    int levels = 0;
+    while ((1u << levels) < threads * PARALLEL_PIECES_PER_THREAD && levels < 20) levels++;
+    if (threads <= 1) levels = 0;
+    cutSubtree(root_, levels, pieces);
+}
+
+/**
+* Calls fn on every item of a piece, in key order.
+*/
+template<typename Key, typename Value>
+template<typename Function>
+void BinarySearchTree<Key, Value>::visitPiece(const TraversalPiece<Key, Value>& piece, Function& fn)
+{
+    if (!piece.wholeSubtree)
+    {
+        fn(piece.node->getItem());
+        return;
+    }
+
+    std::vector<Node<Key, Value>*> stack;
+    Node<Key, Value>* currentNode = piece.node;
+    while (currentNode != nullptr || !stack.empty())
+    {
+        while (currentNode != nullptr)
+        {
+            stack.push_back(currentNode);
+            currentNode = currentNode->getLeft();
+        }
+        currentNode = stack.back();
+        stack.pop_back();
+        fn(currentNode->getItem());
+        currentNode = currentNode->getRight();
+    }
+}
+
+// Claims pieces until none are left and applies fn to each.
+template<typename Key, typename Value, typename Function>
+struct ForEachWorker
+{
+    const std::vector<TraversalPiece<Key, Value> >* pieces;
+    std::atomic<size_t>* next;
+    Function* fn;
+
+    void operator()() const
+    {
+        for (size_t i = (*next)++; i < pieces->size(); i = (*next)++)
+        {
+            BinarySearchTree<Key, Value>::visitPiece((*pieces)[i], *fn);
+        }
+    }
+};
+
+// Folds one piece: result = combine(...combine(map(first), map(second))...)
+template<typename Key, typename Value, typename T, typename Map, typename Combine>
+struct ReduceFold
+{
+    Map* map;
+    Combine* combine;
+    T* result;
+    bool empty;
+
+    void operator()(std::pair<const Key, Value>& item)
+    {
+        if (empty) *result = (*map)(item);
+        else *result = (*combine)(*result, (*map)(item));
+        empty = false;
+    }
+};
+
+// Claims pieces and folds each into its own slot of partials.
+template<typename Key, typename Value, typename T, typename Map, typename Combine>
+struct ReduceWorker
+{
+    const std::vector<TraversalPiece<Key, Value> >* pieces;
+    std::atomic<size_t>* next;
+    std::vector<T>* partials;
+    Map* map;
+    Combine* combine;
+
+    void operator()() const
+    {
+        for (size_t i = (*next)++; i < pieces->size(); i = (*next)++)
+        {
+            ReduceFold<Key, Value, T, Map, Combine> fold = { map, combine, &(*partials)[i], true };
+            BinarySearchTree<Key, Value>::visitPiece((*pieces)[i], fold);
+        }
+    }
+};
+
+/**
+* Calls fn(std::pair<const Key, Value>&) once for every item, spread over
+* threads (0 = every hardware thread). Items are visited in no particular
+* order and fn may run concurrently with itself, so it must be safe to
+* call from several threads. The tree must not be modified meanwhile.
+*/
+template<typename Key, typename Value>
+template<typename Function>
+void BinarySearchTree<Key, Value>::parallelForEach(Function fn, unsigned threads) const
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<TraversalPiece<Key, Value> > pieces;
+    cutPieces(threads, pieces);
+    threads = (unsigned)std::min<size_t>(threads, pieces.size());
+
+    std::atomic<size_t> next(0);
+    ForEachWorker<Key, Value, Function> worker = { &pieces, &next, &fn };
+    std::vector<std::thread> helpers;
+    for (unsigned i = 1; i < threads; i++) helpers.push_back(std::thread(worker));
+    worker();
+    for (size_t i = 0; i < helpers.size(); i++) helpers[i].join();
+}
+
+/**
+* Returns combine(...combine(combine(init, map(item1)), map(item2))..., map(itemN))
+* with the items in key order, computed on several threads (0 = every
+* hardware thread). combine must be associative; it does not have to be
+* commutative since partial results are combined in key order.
+* map(const std::pair<const Key, Value>&) and combine(T, T) may run
+* concurrently.
+*/
+template<typename Key, typename Value>
+template<typename T, typename Map, typename Combine>
+T BinarySearchTree<Key, Value>::parallelReduce(T init, Map map, Combine combine, unsigned threads) const
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<TraversalPiece<Key, Value> > pieces;
+    cutPieces(threads, pieces);
+    threads = (unsigned)std::min<size_t>(threads, pieces.size());
+
+    std::vector<T> partials(pieces.size(), init);
+    std::atomic<size_t> next(0);
+    ReduceWorker<Key, Value, T, Map, Combine> worker = { &pieces, &next, &partials, &map, &combine };
+    std::vector<std::thread> helpers;
+    for (unsigned i = 1; i < threads; i++) helpers.push_back(std::thread(worker));
+    worker();
+    for (size_t i = 0; i < helpers.size(); i++) helpers[i].join();
+
+    // pieces are never empty, so every partial holds a real fold
+    T result = init;
+    for (size_t i = 0; i < partials.size(); i++) result = combine(result, partials[i]);
+    return result;
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "bst.h"
+#include "avlbst.h"
+#include "pooledbst.h"
+
+using namespace std;
+
+// A map with 256-byte values, as an AVLTree and as a PooledAVLTree:
+// inserting random keys, searching without reading the value
+// (contains), searching and reading one word of the value (get), and
+// removing half the keys.
+//   usage: ./pooled-bench [numItems] [numLookups]
+
+struct Payload
+{
+    uint64_t words[32];
+
+    Payload()
+    {
+        memset(words, 0, sizeof(words));
+    }
+};
+
+// BinarySearchTree::print needs one
+ostream& operator<<(ostream& os, const Payload& payload)
+{
+    return os << payload.words[0];
+}
+
+static double nanosSince(chrono::steady_clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ops;
+}
+
+template<typename Map>
+void run(const char* name, const vector<uint64_t>& keys, const vector<uint64_t>& probes)
+{
+    Payload payload;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Map map;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        payload.words[0] = keys[i];
+        map.insert(make_pair(keys[i], payload));
+    }
+    double insertNs = nanosSince(start, keys.size());
+
+    size_t hits = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < probes.size(); i++) hits += map.contains(probes[i]);
+    double containsNs = nanosSince(start, probes.size());
+
+    uint64_t sum = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < probes.size(); i++)
+    {
+        const Payload* value = map.get(probes[i]);
+        if (value != nullptr) sum += value->words[0];
+    }
+    double getNs = nanosSince(start, probes.size());
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i += 2) map.remove(keys[i]);
+    double removeNs = nanosSince(start, keys.size() / 2);
+
+    cout << name << ": insert " << insertNs << " ns/item, contains " << containsNs << " ns/op, get "
+         << getNs << " ns/op, remove " << removeNs << " ns/op" << (hits == 0 || sum == 0 ? " (no hits)" : "") << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t numItems = argc > 1 ? atol(argv[1]) : 400000;
+    size_t numLookups = argc > 2 ? atol(argv[2]) : 2000000;
+
+    mt19937_64 rng(256);
+    vector<uint64_t> keys(numItems);
+    for (size_t i = 0; i < numItems; i++) keys[i] = rng();
+    // half the probes hit
+    vector<uint64_t> probes(numLookups);
+    for (size_t i = 0; i < numLookups; i++) probes[i] = i % 2 ? keys[rng() % numItems] : rng();
+
+    run<AVLTree<uint64_t, Payload> >("AVLTree      ", keys, probes);
+    run<PooledAVLTree<uint64_t, Payload> >("PooledAVLTree", keys, probes);
+    return 0;
+}
@@ -0,0 +1,322 @@
+#ifndef POOLEDBST_H
+#define POOLEDBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "avlbst.h"
+#include "indexedavl.h"
+
+/**
+* An AVL map whose nodes live in two pooled arrays indexed by node number:
+* a hot array with each node's key, links and balance, and a cold array
+* with the values. A search only touches the hot array, so large values
+* stay out of the cache until one is actually read, and the hot array
+* packs several nodes per cache line. Links are 32-bit indices, so the
+* map holds fewer than 2^32 - 1 items. Freed slots are reused; the arrays
+* only shrink on clear().
+*
+* Insert and remove rebalance with IndexedAVL (indexedavl.h), exactly
+* like AVLTree and FixedAVLTree. A node with two
+* children is removed by moving its predecessor's key and value into it.
+* Pointers returned by get() are invalidated by insert and remove.
+*/
+template <class Key, class Value>
+class PooledAVLTree
+{
+public:
+    PooledAVLTree();
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    void remove(const Key& key);
+    void clear();
+
+    bool contains(const Key& key) const;
+    Value* get(const Key& key);
+    const Value* get(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+    template<typename Function>
+    void forEach(Function fn) const;
+
+    size_t size() const;
+    bool empty() const;
+    bool isBalanced() const;
+    MemoryUsage memoryUsage() const;
+
+protected:
+    static const uint32_t NIL = UINT32_MAX;
+
+    struct HotNode
+    {
+        Key key;
+        uint32_t left;
+        uint32_t right; // next free slot while on the free list
+        uint32_t parent;
+        int8_t balance;
+    };
+
+    typedef IndexedAVL<HotNode, uint32_t, NIL> Rebalance;
+
+    uint32_t internalFind(const Key& key) const;
+    uint32_t allocate(const Key& key, const Value& value, uint32_t parent);
+    void release(uint32_t index);
+
+protected:
+    std::vector<HotNode> hot_;
+    std::vector<Value> values_;
+    uint32_t root_;
+    uint32_t free_;
+    size_t size_;
+};
+
+template<class Key, class Value>
+PooledAVLTree<Key, Value>::PooledAVLTree() :
+    root_(NIL), free_(NIL), size_(0)
+{
+
+}
+
+/**
+* Inserts new_item, overwriting the value if the key is already present.
+*/
+template<class Key, class Value>
+void PooledAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    if (root_ == NIL)
+    {
+        root_ = allocate(new_item.first, new_item.second, NIL);
+        return;
+    }
+
+    uint32_t parent = root_;
+    while (true)
+    {
+        const HotNode& current = hot_[parent];
+        if (current.key == new_item.first)
+        {
+            values_[parent] = new_item.second;
+            return;
+        }
+        uint32_t next = new_item.first < current.key ? current.left : current.right;
+        if (next == NIL) break;
+        parent = next;
+    }
+
+    // allocate may grow the pool, so the array is taken afterwards
+    uint32_t newNode = allocate(new_item.first, new_item.second, parent);
+    Rebalance(hot_.data(), root_).attachLeaf(parent, newNode, new_item.first < hot_[parent].key);
+}
+
+template<class Key, class Value>
+void PooledAVLTree<Key, Value>::remove(const Key& key)
+{
+    uint32_t nodeToRemove = internalFind(key);
+    if (nodeToRemove == NIL) return;
+
+    if (hot_[nodeToRemove].left != NIL && hot_[nodeToRemove].right != NIL)
+    {
+        uint32_t predecessor = hot_[nodeToRemove].left;
+        while (hot_[predecessor].right != NIL) predecessor = hot_[predecessor].right;
+        hot_[nodeToRemove].key = hot_[predecessor].key;
+        values_[nodeToRemove] = std::move(values_[predecessor]);
+        nodeToRemove = predecessor;
+    }
+
+    Rebalance(hot_.data(), root_).detach(nodeToRemove);
+    release(nodeToRemove);
+}
+
+/**
+* Removes every item and frees both arrays.
+*/
+template<class Key, class Value>
+void PooledAVLTree<Key, Value>::clear()
+{
+    std::vector<HotNode>().swap(hot_);
+    std::vector<Value>().swap(values_);
+    root_ = NIL;
+    free_ = NIL;
+    size_ = 0;
+}
+
+template<class Key, class Value>
+bool PooledAVLTree<Key, Value>::contains(const Key& key) const
+{
+    return internalFind(key) != NIL;
+}
+
+/**
+* Returns a pointer to the value for key, or NULL if it is not present.
+*/
+template<class Key, class Value>
+Value* PooledAVLTree<Key, Value>::get(const Key& key)
+{
+    uint32_t found = internalFind(key);
+    return found == NIL ? nullptr : &values_[found];
+}
+
+template<class Key, class Value>
+const Value* PooledAVLTree<Key, Value>::get(const Key& key) const
+{
+    uint32_t found = internalFind(key);
+    return found == NIL ? nullptr : &values_[found];
+}
+
+template<class Key, class Value>
+Value& PooledAVLTree<Key, Value>::operator[](const Key& key)
+{
+    Value* value = get(key);
+    if (value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+template<class Key, class Value>
+Value const & PooledAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    const Value* value = get(key);
+    if (value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+/**
+* Calls fn(key, value) for every item in key order.
+*/
+template<class Key, class Value>
+template<typename Function>
+void PooledAVLTree<Key, Value>::forEach(Function fn) const
+{
+    uint32_t current = root_;
+    while (current != NIL && hot_[current].left != NIL) current = hot_[current].left;
+    while (current != NIL)
+    {
+        fn(hot_[current].key, values_[current]);
+        if (hot_[current].right != NIL)
+        {
+            current = hot_[current].right;
+            while (hot_[current].left != NIL) current = hot_[current].left;
+            continue;
+        }
+        uint32_t parent = hot_[current].parent;
+        while (parent != NIL && hot_[parent].right == current)
+        {
+            current = parent;
+            parent = hot_[parent].parent;
+        }
+        current = parent;
+    }
+}
+
+template<class Key, class Value>
+size_t PooledAVLTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+bool PooledAVLTree<Key, Value>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Return true iff every node's subtrees differ in height by at most one
+* and its balance factor says so.
+*/
+template<class Key, class Value>
+bool PooledAVLTree<Key, Value>::isBalanced() const
+{
+    return Rebalance::checkHeight(hot_.data(), root_) != -1;
+}
+
+/**
+* Memory used by the pools, as for BinarySearchTree::memoryUsage().
+* nodeBytes counts the hot and cold entry of every item; allocatorSlack
+* is the unused capacity of both arrays, including free slots.
+*/
+template<class Key, class Value>
+MemoryUsage PooledAVLTree<Key, Value>::memoryUsage() const
+{
+    MemoryUsage usage;
+    size_t perNode = sizeof(HotNode) + sizeof(Value);
+    usage.nodeCount = size_;
+    usage.nodeBytes = perNode * size_;
+    usage.allocatorSlack = hot_.capacity() * sizeof(HotNode) + values_.capacity() * sizeof(Value) - usage.nodeBytes;
+    usage.payloadBytes = sizeof(std::pair<const Key, Value>) * size_;
+    usage.heapBytes = 0;
+    if (HeapBytes<Key>::tracked || HeapBytes<Value>::tracked)
+    {
+        forEach([&usage](const Key& key, const Value& value) {
+            usage.heapBytes += HeapBytes<Key>::of(key) + HeapBytes<Value>::of(value);
+        });
+    }
+    return usage;
+}
+
+template<class Key, class Value>
+uint32_t PooledAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    uint32_t current = root_;
+    while (current != NIL)
+    {
+        const HotNode& node = hot_[current];
+        if (node.key == key) return current;
+        current = key < node.key ? node.left : node.right;
+    }
+    return NIL;
+}
+
+/*
+ * Takes a slot off the free list, or appends one, for a new leaf. The
+ * value is copied first, so if that throws the pool is unchanged.
+ */
+template<class Key, class Value>
+uint32_t PooledAVLTree<Key, Value>::allocate(const Key& key, const Value& value, uint32_t parent)
+{
+    HotNode node = { key, NIL, NIL, parent, 0 };
+    uint32_t index = free_;
+    if (index != NIL)
+    {
+        values_[index] = value;
+        free_ = hot_[index].right;
+        hot_[index] = node;
+    }
+    else
+    {
+        if (hot_.size() >= NIL) throw std::length_error("PooledAVLTree is full");
+        index = (uint32_t)hot_.size();
+        values_.push_back(value);
+        try
+        {
+            hot_.push_back(node);
+        }
+        catch (...)
+        {
+            values_.pop_back();
+            throw;
+        }
+    }
+    size_++;
+    return index;
+}
+
+/*
+ * Puts a slot on the free list. Its key and value are reset so whatever
+ * they own is freed now rather than when the slot is reused.
+ */
+template<class Key, class Value>
+void PooledAVLTree<Key, Value>::release(uint32_t index)
+{
+    hot_[index].key = Key();
+    values_[index] = Value();
+    hot_[index].right = free_;
+    free_ = index;
+    size_--;
+}
+
+#endif
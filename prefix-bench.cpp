@@ -0,0 +1,69 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "bst.h"
+#include "avlbst.h"
+#include "prefixbst.h"
+
+using namespace std;
+
+// Looks up URL-like string keys ("host/path/id", longer than the inline
+// string buffer) in an AVLTree and in a PrefixAVLTree, half of them hits.
+//   usage: ./prefix-bench [numKeys] [numLookups]
+
+static string makeUrl(mt19937_64& rng)
+{
+    static const char* words[] = { "shop", "news", "mail", "docs", "blog", "wiki", "maps", "play" };
+    static const char* paths[] = { "/items/", "/articles/", "/users/", "/search?q=" };
+    string url = words[rng() % 8];
+    url += to_string(rng() % 100000);
+    url += ".example.com";
+    url += paths[rng() % 4];
+    url += to_string(rng());
+    return url;
+}
+
+template<typename Tree>
+double timeLookups(const Tree& tree, const vector<string>& probes, size_t& hits)
+{
+    hits = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < probes.size(); i++)
+    {
+        if (tree.find(probes[i]) != tree.end()) hits++;
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(stop - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    size_t numKeys = argc > 1 ? atol(argv[1]) : 500000;
+    size_t numLookups = argc > 2 ? atol(argv[2]) : 2000000;
+
+    mt19937_64 rng(106);
+    vector<string> keys(numKeys);
+    AVLTree<string, int> plain;
+    PrefixAVLTree<int> prefixed;
+    for (size_t i = 0; i < numKeys; i++)
+    {
+        keys[i] = makeUrl(rng);
+        plain.insert(make_pair(keys[i], (int)i));
+        prefixed.insert(make_pair(keys[i], (int)i));
+    }
+
+    vector<string> probes(numLookups);
+    for (size_t i = 0; i < numLookups; i++) probes[i] = (i % 2) ? keys[rng() % numKeys] : makeUrl(rng);
+
+    size_t plainHits, prefixHits;
+    double plainMs = timeLookups(plain, probes, plainHits);
+    double prefixMs = timeLookups(prefixed, probes, prefixHits);
+
+    cout << "keys=" << numKeys << " lookups=" << numLookups << endl;
+    cout << "AVLTree       : " << plainMs << " ms (" << plainHits << " hits)" << endl;
+    cout << "PrefixAVLTree : " << prefixMs << " ms (" << prefixHits << " hits)" << endl;
+    return 0;
+}
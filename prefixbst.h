@@ -0,0 +1,230 @@
+#ifndef PREFIXBST_H
+#define PREFIXBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include "avlbst.h"
+
+/**
+* The first 8 bytes of key as a big-endian integer, padded with zero
+* bytes. If the prefixes of two keys differ, comparing them as integers
+* orders the keys the same way std::string does.
+*/
+inline uint64_t keyPrefix(const std::string& key)
+{
+    uint64_t prefix = 0;
+    size_t length = key.size() < 8 ? key.size() : 8;
+    for (size_t i = 0; i < 8; i++)
+    {
+        prefix <<= 8;
+        if (i < length) prefix |= (unsigned char)key[i];
+    }
+    return prefix;
+}
+
+/**
+* An AVLNode for string keys that keeps the key's prefix inline, next to
+* the links, so most comparisons during a descent never touch the
+* string's heap buffer.
+*/
+template <typename Value>
+class PrefixAVLNode : public AVLNode<std::string, Value>
+{
+public:
+    PrefixAVLNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent);
+    virtual ~PrefixAVLNode();
+
+    uint64_t getPrefix() const;
+
+    virtual PrefixAVLNode<Value>* clone(Node<std::string, Value>* parent) const override;
+
+protected:
+    uint64_t prefix_;
+};
+
+template<class Value>
+PrefixAVLNode<Value>::PrefixAVLNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent) :
+    AVLNode<std::string, Value>(key, value, parent), prefix_(keyPrefix(key))
+{
+
+}
+
+template<class Value>
+PrefixAVLNode<Value>::~PrefixAVLNode()
+{
+
+}
+
+template<class Value>
+uint64_t PrefixAVLNode<Value>::getPrefix() const
+{
+    return prefix_;
+}
+
+template<class Value>
+PrefixAVLNode<Value>* PrefixAVLNode<Value>::clone(Node<std::string, Value>* parent) const
+{
+    PrefixAVLNode<Value>* copy = new PrefixAVLNode<Value>(this->getKey(), this->getValue(),
+                                                          static_cast<AVLNode<std::string, Value>*>(parent));
+    copy->setBalance(this->balance_);
+    return copy;
+}
+
+/**
+* An AVLTree with string keys whose lookups compare cached key prefixes
+* first and only fall back to a full string comparison when the first 8
+* bytes are equal. This pays off when keys are longer than the strings
+* stored inline (15 bytes with libstdc++) and mostly differ early; keys
+* that all share their first 8 bytes gain nothing.
+*
+* find, operator[], insert and remove use the prefixes. Other operations
+* work as in AVLTree.
+*/
+template <class Value>
+class PrefixAVLTree : public AVLTree<std::string, Value>
+{
+public:
+    typedef typename AVLTree<std::string, Value>::iterator iterator;
+
+    virtual void insert(const std::pair<const std::string, Value>& new_item);
+    virtual void remove(const std::string& key);
+    using AVLTree<std::string, Value>::insert;
+
+    iterator find(const std::string& key) const;
+    Value& operator[](const std::string& key);
+    Value const & operator[](const std::string& key) const;
+
+protected:
+    typedef PrefixAVLNode<Value> PrefixNode;
+
+    virtual AVLNode<std::string, Value>* createNode(const std::string& key, const Value& value,
+                                                    AVLNode<std::string, Value>* parent);
+    virtual size_t nodeBytes() const;
+    virtual const std::type_info& nodeType() const;
+
+    PrefixNode* descend(const std::string& key, uint64_t prefix) const;
+    PrefixNode* prefixFind(const std::string& key) const;
+    static int compareKey(const std::string& key, uint64_t prefix, const PrefixNode* thisNode);
+};
+
+template<class Value>
+void PrefixAVLTree<Value>::insert(const std::pair<const std::string, Value>& new_item)
+{
+    uint64_t prefix = keyPrefix(new_item.first);
+    PrefixNode* parent = descend(new_item.first, prefix);
+    int order = (parent == nullptr) ? 0 : compareKey(new_item.first, prefix, parent);
+    if (parent != nullptr && order == 0)
+    {
+        parent->setValue(new_item.second);
+        return;
+    }
+
+    AVLNode<std::string, Value>* newNode = createNode(new_item.first, new_item.second, parent);
+    if (parent == nullptr) this->attachNode(parent, newNode);
+    else this->linkNode(parent, newNode, order < 0);
+}
+
+template<class Value>
+void PrefixAVLTree<Value>::remove(const std::string& key)
+{
+    PrefixNode* nodeToRemove = prefixFind(key);
+    if (nodeToRemove == nullptr) return;
+    this->unlinkNode(nodeToRemove);
+    delete nodeToRemove;
+}
+
+template<class Value>
+typename PrefixAVLTree<Value>::iterator PrefixAVLTree<Value>::find(const std::string& key) const
+{
+    return this->makeIterator(prefixFind(key));
+}
+
+template<class Value>
+Value& PrefixAVLTree<Value>::operator[](const std::string& key)
+{
+    PrefixNode* curr = prefixFind(key);
+    if (curr == nullptr) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Value>
+Value const & PrefixAVLTree<Value>::operator[](const std::string& key) const
+{
+    PrefixNode* curr = prefixFind(key);
+    if (curr == nullptr) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/*
+ * Returns the node holding key, or NULL.
+ */
+template<class Value>
+typename PrefixAVLTree<Value>::PrefixNode* PrefixAVLTree<Value>::prefixFind(const std::string& key) const
+{
+    uint64_t prefix = keyPrefix(key);
+    PrefixNode* found = descend(key, prefix);
+    if (found == nullptr || compareKey(key, prefix, found) != 0) return nullptr;
+    return found;
+}
+
+/*
+ * Returns the node holding key if there is one, otherwise the node whose
+ * empty child slot the key belongs in (NULL if the tree is empty).
+ */
+template<class Value>
+typename PrefixAVLTree<Value>::PrefixNode* PrefixAVLTree<Value>::descend(const std::string& key, uint64_t prefix) const
+{
+    PrefixNode* currentNode = static_cast<PrefixNode*>(this->root_);
+    if (currentNode == nullptr) return nullptr;
+
+    // appending past the largest key: the rightmost node has a free right slot
+    if (compareKey(key, prefix, static_cast<PrefixNode*>(this->rightmost_)) > 0)
+    {
+        return static_cast<PrefixNode*>(this->rightmost_);
+    }
+
+    while (true)
+    {
+        int order = compareKey(key, prefix, currentNode);
+        if (order == 0) return currentNode;
+        PrefixNode* nextNode = static_cast<PrefixNode*>(order < 0 ? currentNode->getLeft() : currentNode->getRight());
+        if (nextNode == nullptr) return currentNode;
+        currentNode = nextNode;
+    }
+}
+
+/*
+ * Negative, zero or positive as key is before, equal to or after the key
+ * of thisNode. prefix must be keyPrefix(key).
+ */
+template<class Value>
+int PrefixAVLTree<Value>::compareKey(const std::string& key, uint64_t prefix, const PrefixNode* thisNode)
+{
+    if (prefix != thisNode->getPrefix()) return prefix < thisNode->getPrefix() ? -1 : 1;
+    return key.compare(thisNode->getKey());
+}
+
+template<class Value>
+AVLNode<std::string, Value>* PrefixAVLTree<Value>::createNode(const std::string& key, const Value& value,
+                                                              AVLNode<std::string, Value>* parent)
+{
+    return new PrefixNode(key, value, parent);
+}
+
+template<class Value>
+size_t PrefixAVLTree<Value>::nodeBytes() const
+{
+    return sizeof(PrefixNode);
+}
+
+template<class Value>
+const std::type_info& PrefixAVLTree<Value>::nodeType() const
+{
+    return typeid(PrefixNode);
+}
+
+#endif
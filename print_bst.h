@@ -222,7 +222,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
                     for(int numLines = 0; numLines < (elementPadding/2 - 1); ++numLines)
                     {
-                        std::cout << u8"\u2500";
+                        std::cout << "\xe2\x94\x80"; // U+2500, UTF-8 encoded
                     }
 
                     std::cout << "\u2518  ";
@@ -239,7 +239,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
                     for(int numLines = 0; numLines < (elementPadding/2 - 1); ++numLines)
                     {
-                        std::cout << u8"\u2500";
+                        std::cout << "\xe2\x94\x80"; // U+2500, UTF-8 encoded
                     }
 
                     std::cout << "\u2510  ";
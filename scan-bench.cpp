@@ -0,0 +1,78 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Sums the values of a large AVLTree by walking its iterator, and with
+// parallelReduce on one thread and on every thread.
+//   usage: ./scan-bench [numItems]
+
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+template<typename Scan>
+double timeScan(Scan scan, uint64_t& sum)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    sum = scan();
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(stop - start).count();
+}
+
+struct IteratorSum
+{
+    const Tree* tree;
+    uint64_t operator()() const
+    {
+        uint64_t sum = 0;
+        for (Tree::iterator it = tree->begin(); it != tree->end(); ++it) sum += it->second;
+        return sum;
+    }
+};
+
+struct ValueOf
+{
+    uint64_t operator()(const pair<const uint64_t, uint64_t>& item) const { return item.second; }
+};
+
+struct Add
+{
+    uint64_t operator()(uint64_t lhs, uint64_t rhs) const { return lhs + rhs; }
+};
+
+struct ParallelSum
+{
+    const Tree* tree;
+    unsigned threads;
+    uint64_t operator()() const
+    {
+        return tree->parallelReduce(uint64_t(0), ValueOf(), Add(), threads);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    size_t numItems = argc > 1 ? atol(argv[1]) : 2000000;
+    mt19937_64 rng(105);
+    vector<pair<uint64_t, uint64_t> > items(numItems);
+    for (size_t i = 0; i < numItems; i++) items[i] = make_pair(rng(), i);
+    Tree tree;
+    tree.bulkBuild(items);
+
+    unsigned hardwareThreads = max(1u, thread::hardware_concurrency());
+    IteratorSum iteratorSum = { &tree };
+    ParallelSum parallelOne = { &tree, 1 };
+    ParallelSum parallelAll = { &tree, hardwareThreads };
+
+    uint64_t sum;
+    cout << "items=" << numItems << endl;
+    cout << "iterator walk            : " << timeScan(iteratorSum, sum) << " ms (sum " << sum << ")" << endl;
+    cout << "parallelReduce, 1 thread : " << timeScan(parallelOne, sum) << " ms (sum " << sum << ")" << endl;
+    cout << "parallelReduce, " << hardwareThreads << " threads : " << timeScan(parallelAll, sum) << " ms (sum " << sum << ")" << endl;
+    return 0;
+}
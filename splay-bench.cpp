@@ -0,0 +1,87 @@
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include "bst.h"
+#include "avlbst.h"
+#include "splaybst.h"
+
+using namespace std;
+
+// Lookups follow a Zipf distribution over the key space, so a small set of
+// keys receives most of the traffic.
+//   usage: ./splay-bench [numKeys] [numLookups] [zipfExponent]
+
+vector<int> makeZipfTrace(int numKeys, int numLookups, double exponent, mt19937_64& rng)
+{
+    vector<double> cdf(numKeys);
+    double total = 0;
+    for (int rank = 0; rank < numKeys; rank++)
+    {
+        total += 1.0 / pow(rank + 1, exponent);
+        cdf[rank] = total;
+    }
+
+    // ranks are mapped to random keys so the hot keys are spread over the tree
+    vector<int> keyOfRank(numKeys);
+    for (int i = 0; i < numKeys; i++) keyOfRank[i] = i;
+    shuffle(keyOfRank.begin(), keyOfRank.end(), rng);
+
+    uniform_real_distribution<double> uniform(0, total);
+    vector<int> trace(numLookups);
+    for (int i = 0; i < numLookups; i++)
+    {
+        int rank = lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        trace[i] = keyOfRank[min(rank, numKeys - 1)];
+    }
+    return trace;
+}
+
+template<typename Tree>
+double runLookups(Tree& tree, const vector<int>& trace, long long& checksum)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        checksum += tree[trace[i]];
+    }
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(stop - start).count() / trace.size();
+}
+
+template<typename Tree>
+void fill(Tree& tree, int numKeys, mt19937_64& rng)
+{
+    vector<int> keys(numKeys);
+    for (int i = 0; i < numKeys; i++) keys[i] = i;
+    shuffle(keys.begin(), keys.end(), rng);
+    for (int i = 0; i < numKeys; i++) tree.insert(make_pair(keys[i], keys[i]));
+}
+
+int main(int argc, char *argv[])
+{
+    int numKeys = argc > 1 ? atoi(argv[1]) : 200000;
+    int numLookups = argc > 2 ? atoi(argv[2]) : 2000000;
+    double exponent = argc > 3 ? atof(argv[3]) : 1.1;
+
+    mt19937_64 rng(104);
+    vector<int> trace = makeZipfTrace(numKeys, numLookups, exponent, rng);
+
+    AVLTree<int, int> avl;
+    SplayTree<int, int> splay;
+    SplayTree<int, int> semiSplay(true);
+    fill(avl, numKeys, rng);
+    fill(splay, numKeys, rng);
+    fill(semiSplay, numKeys, rng);
+
+    long long checksum = 0;
+    cout << "keys=" << numKeys << " lookups=" << numLookups << " zipf s=" << exponent << endl;
+    cout << "AVLTree         : " << runLookups(avl, trace, checksum) << " ns/lookup" << endl;
+    cout << "SplayTree       : " << runLookups(splay, trace, checksum) << " ns/lookup" << endl;
+    cout << "SplayTree(semi) : " << runLookups(semiSplay, trace, checksum) << " ns/lookup" << endl;
+    cout << "(checksum " << checksum << ")" << endl;
+    return 0;
+}
@@ -0,0 +1,222 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include "bst.h"
+
+/**
+* A self-adjusting binary search tree. Every access (find, operator[], insert,
+* remove) moves the touched node to the root, so keys that are looked up often
+* stay near the top of the tree and skewed workloads get amortized faster than
+* O(log n) lookups.
+*
+* In semi-splay mode the zig-zig step only rotates the parent over the
+* grandparent and continues from the parent, which roughly halves the depth of
+* the access path while doing about half the pointer writes of a full splay.
+*/
+template <class Key, class Value>
+class SplayTree : public BinarySearchTree<Key, Value>
+{
+public:
+    SplayTree(bool semiSplay = false);
+
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    virtual void remove(const Key& key);
+    using BinarySearchTree<Key, Value>::insert;
+
+    // The const overloads from BinarySearchTree stay available and do not splay.
+    using BinarySearchTree<Key, Value>::find;
+    using BinarySearchTree<Key, Value>::operator[];
+    typename BinarySearchTree<Key, Value>::iterator find(const Key& key);
+    Value& operator[](const Key& key);
+
+    bool isSemiSplay() const;
+    void setSemiSplay(bool semiSplay);
+    virtual void swap(BinarySearchTree<Key, Value>& other);
+
+protected:
+    // Add helper functions here
+    Node<Key, Value>* descend(const Key& key) const;
+    void splay(Node<Key, Value>* thisNode);
+    void rotateUp(Node<Key, Value>* thisNode);
+
+protected:
+    bool semiSplay_;
+};
+
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(bool semiSplay) :
+    BinarySearchTree<Key, Value>(), semiSplay_(semiSplay)
+{
+
+}
+
+template<class Key, class Value>
+bool SplayTree<Key, Value>::isSemiSplay() const
+{
+    return semiSplay_;
+}
+
+template<class Key, class Value>
+void SplayTree<Key, Value>::setSemiSplay(bool semiSplay)
+{
+    semiSplay_ = semiSplay;
+}
+
+/*
+ * The splay mode goes with the nodes when other is a SplayTree too.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::swap(BinarySearchTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::swap(other);
+    SplayTree<Key, Value>* splayOther = dynamic_cast<SplayTree<Key, Value>*>(&other);
+    if (splayOther != nullptr) std::swap(semiSplay_, splayOther->semiSplay_);
+}
+
+/**
+* Splays the found node (or the last node on the search path on a miss) to the
+* root. The base class lookup then resolves at the root in one comparison.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+SplayTree<Key, Value>::find(const Key& key)
+{
+    splay(descend(key));
+    return BinarySearchTree<Key, Value>::find(key);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key, after splaying it to the root.
+ */
+template<class Key, class Value>
+Value& SplayTree<Key, Value>::operator[](const Key& key)
+{
+    splay(descend(key));
+    return BinarySearchTree<Key, Value>::operator[](key);
+}
+
+/*
+ * If key is already in the tree its value is overwritten.
+ * Either way the node holding the key ends up at the root.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Node<Key, Value>* parent = descend(keyValuePair.first);
+    if (parent != nullptr && parent->getKey() == keyValuePair.first)
+    {
+        parent->setValue(keyValuePair.second);
+        splay(parent);
+        return;
+    }
+
+    Node<Key, Value>* newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, parent);
+    this->size_++;
+    if (parent == nullptr) this->root_ = newNode;
+    else if (keyValuePair.first < parent->getKey()) parent->setLeft(newNode);
+    else parent->setRight(newNode);
+
+    splay(newNode);
+}
+
+/*
+ * The node is splayed to the root first, so the base class removal finds it
+ * immediately and only has to walk down to the predecessor.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* nodeToRemove = descend(key);
+    splay(nodeToRemove);
+    if (nodeToRemove == nullptr || key < nodeToRemove->getKey() || nodeToRemove->getKey() < key) return;
+    BinarySearchTree<Key, Value>::remove(key);
+}
+
+/**
+* Returns the node with the given key, or the last node on the search path
+* if the key is not in the tree (nullptr only for an empty tree).
+*/
+template<class Key, class Value>
+Node<Key, Value>* SplayTree<Key, Value>::descend(const Key& key) const
+{
+    Node<Key, Value>* currentNode = this->root_;
+    Node<Key, Value>* lastNode = nullptr;
+    while (currentNode != nullptr)
+    {
+        lastNode = currentNode;
+        if (currentNode->getKey() == key) return currentNode;
+        if (key < currentNode->getKey()) currentNode = currentNode->getLeft();
+        else currentNode = currentNode->getRight();
+    }
+    return lastNode;
+}
+
+template<class Key, class Value>
+void SplayTree<Key, Value>::splay(Node<Key, Value>* thisNode)
+{
+    if (thisNode == nullptr) return;
+
+    while (thisNode->getParent() != nullptr)
+    {
+        Node<Key, Value>* parent = thisNode->getParent();
+        Node<Key, Value>* grandParent = parent->getParent();
+
+        // zig
+        if (grandParent == nullptr)
+        {
+            rotateUp(thisNode);
+            return;
+        }
+
+        bool zigZig = (grandParent->getLeft() == parent) == (parent->getLeft() == thisNode);
+        if (zigZig)
+        {
+            rotateUp(parent);
+            // semi-splay stops the zig-zig after one rotation and carries on from the parent
+            if (semiSplay_) thisNode = parent;
+            else rotateUp(thisNode);
+        }
+        else // zig zag
+        {
+            rotateUp(thisNode);
+            rotateUp(thisNode);
+        }
+    }
+}
+
+/**
+* Rotates thisNode above its parent, keeping the in-order sequence intact.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::rotateUp(Node<Key, Value>* thisNode)
+{
+    Node<Key, Value>* parent = thisNode->getParent();
+    Node<Key, Value>* grandParent = parent->getParent();
+
+    if (parent->getLeft() == thisNode)
+    {
+        Node<Key, Value>* moved = thisNode->getRight();
+        parent->setLeft(moved);
+        if (moved != nullptr) moved->setParent(parent);
+        thisNode->setRight(parent);
+    }
+    else
+    {
+        Node<Key, Value>* moved = thisNode->getLeft();
+        parent->setRight(moved);
+        if (moved != nullptr) moved->setParent(parent);
+        thisNode->setLeft(parent);
+    }
+    parent->setParent(thisNode);
+    thisNode->setParent(grandParent);
+
+    if (grandParent == nullptr) this->root_ = thisNode;
+    else if (grandParent->getLeft() == parent) grandParent->setLeft(thisNode);
+    else grandParent->setRight(thisNode);
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "bst.h"
+#include "avlbst.h"
+#include "splaybst.h"
+#include "filterbst.h"
+#include "bufferedbst.h"
+#include "tracedbst.h"
+
+using namespace std;
+
+// Records workload traces and replays them against the tree engines,
+// reporting throughput and per-operation latency percentiles.
+//
+//   usage: ./trace-replay record <file> [numOps]
+//              writes a synthetic trace (skewed finds, inserts, removes
+//              and short range scans) through a TracedTree
+//          ./trace-replay replay <file> [engine ...]
+//              engines: bst avl splay filter buffered (default: all but bst,
+//              which degenerates on sorted input)
+//
+// Latencies are timed one operation at a time, so each includes the
+// ~20-30 ns of reading the clock.
+
+typedef int64_t Key;
+typedef uint64_t Value;
+
+static const char* opNames[] = { "", "insert", "find", "remove", "range" };
+
+// Each engine is driven through these; the overloads cover the engines
+// without find()/lowerBound().
+template<typename Tree>
+void replayInsert(Tree& tree, Key key, Value value)
+{
+    tree.insert(make_pair(key, value));
+}
+
+template<typename Tree>
+bool replayFind(Tree& tree, Key key)
+{
+    return tree.find(key) != tree.end();
+}
+
+bool replayFind(BufferedAVLTree<Key, Value>& tree, Key key)
+{
+    return tree.contains(key);
+}
+
+template<typename Tree>
+void replayRemove(Tree& tree, Key key)
+{
+    tree.remove(key);
+}
+
+template<typename Tree>
+Value replayRange(const Tree& tree, Key lo, Key hi)
+{
+    Value sum = 0;
+    for (typename Tree::iterator it = tree.lowerBound(lo); it != tree.end() && !(hi < it->first); ++it)
+    {
+        sum += it->second;
+    }
+    return sum;
+}
+
+// Ranges read the merged tree, so they flush the write buffer first.
+Value replayRange(BufferedAVLTree<Key, Value>& tree, Key lo, Key hi)
+{
+    return replayRange(tree.mergedTree(), lo, hi);
+}
+
+static uint32_t percentile(const vector<uint32_t>& sorted, double fraction)
+{
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+template<typename Tree>
+void replay(const string& engine, Tree& tree, const vector<TraceRecord>& trace)
+{
+    vector<uint32_t> latencies[TRACE_RANGE + 1];
+    for (int op = TRACE_INSERT; op <= TRACE_RANGE; op++) latencies[op].reserve(trace.size());
+    size_t hits = 0;
+    Value rangeSum = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point before = start;
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        const TraceRecord& record = trace[i];
+        switch (record.op)
+        {
+        case TRACE_INSERT: replayInsert(tree, record.key, record.arg); break;
+        case TRACE_FIND: hits += replayFind(tree, record.key); break;
+        case TRACE_REMOVE: replayRemove(tree, record.key); break;
+        case TRACE_RANGE: rangeSum += replayRange(tree, record.key, (Key)(record.key + record.arg)); break;
+        }
+        chrono::steady_clock::time_point after = chrono::steady_clock::now();
+        latencies[record.op].push_back((uint32_t)chrono::duration_cast<chrono::nanoseconds>(after - before).count());
+        before = after;
+    }
+    double totalMs = chrono::duration<double, milli>(before - start).count();
+
+    cout << engine << ": " << trace.size() << " ops in " << totalMs << " ms ("
+         << trace.size() / totalMs / 1000 << " Mops/s), " << hits << " find hits, range sum " << rangeSum << endl;
+    cout << "  op        count      p50      p90      p99    p99.9      max  (ns)" << endl;
+    for (int op = TRACE_INSERT; op <= TRACE_RANGE; op++)
+    {
+        vector<uint32_t>& sorted = latencies[op];
+        if (sorted.empty()) continue;
+        sort(sorted.begin(), sorted.end());
+        cout << "  " << opNames[op] << string(7 - strlen(opNames[op]), ' ');
+        cout.width(8);
+        cout << sorted.size();
+        double fractions[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+        for (size_t f = 0; f < 5; f++)
+        {
+            cout.width(9);
+            cout << percentile(sorted, fractions[f]);
+        }
+        cout << endl;
+    }
+}
+
+// A mixed workload: finds (mostly on a hot tenth of the keys), inserts,
+// removes and scans over 400 consecutive keys.
+static void record(const string& path, size_t numOps)
+{
+    ofstream file(path.c_str(), ios::binary);
+    if (!file) throw runtime_error("cannot write " + path);
+    TraceWriter writer(file);
+
+    mt19937_64 rng(108);
+    Key keySpace = (Key)numOps;
+    TracedTree<Key, Value> tree;
+    tree.startTrace(&writer);
+    for (size_t i = 0; i < numOps; i++)
+    {
+        Key key = (Key)(rng() % (uint64_t)keySpace);
+        unsigned roll = rng() % 100;
+        if (roll < 30) tree.insert(make_pair(key, (Value)i));
+        else if (roll < 40) tree.remove(key);
+        else if (roll < 95) tree.find(roll < 80 ? key / 10 : key);
+        else tree.forEachInRange(key, key + 400, [](const pair<const Key, Value>&) { });
+    }
+    tree.stopTrace();
+    file.close();
+    if (!file) throw runtime_error("cannot write " + path);
+    cout << "recorded " << writer.records() << " ops to " << path << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || (strcmp(argv[1], "record") != 0 && strcmp(argv[1], "replay") != 0))
+    {
+        cerr << "usage: " << argv[0] << " record <file> [numOps]" << endl;
+        cerr << "       " << argv[0] << " replay <file> [bst|avl|splay|filter|buffered ...]" << endl;
+        return 1;
+    }
+
+    try
+    {
+        if (strcmp(argv[1], "record") == 0)
+        {
+            record(argv[2], argc > 3 ? atol(argv[3]) : 2000000);
+            return 0;
+        }
+
+        ifstream file(argv[2], ios::binary);
+        if (!file) throw runtime_error(string("cannot read ") + argv[2]);
+        vector<TraceRecord> trace;
+        readTrace(file, trace);
+
+        vector<string> engines;
+        for (int i = 3; i < argc; i++) engines.push_back(argv[i]);
+        if (engines.empty())
+        {
+            const char* defaults[] = { "avl", "splay", "filter", "buffered" };
+            engines.assign(defaults, defaults + 4);
+        }
+
+        for (size_t i = 0; i < engines.size(); i++)
+        {
+            if (engines[i] == "bst")
+            {
+                BinarySearchTree<Key, Value> tree;
+                replay(engines[i], tree, trace);
+            }
+            else if (engines[i] == "avl")
+            {
+                AVLTree<Key, Value> tree;
+                replay(engines[i], tree, trace);
+            }
+            else if (engines[i] == "splay")
+            {
+                SplayTree<Key, Value> tree;
+                replay(engines[i], tree, trace);
+            }
+            else if (engines[i] == "filter")
+            {
+                FilteredAVLTree<Key, Value> tree;
+                replay(engines[i], tree, trace);
+            }
+            else if (engines[i] == "buffered")
+            {
+                BufferedAVLTree<Key, Value> tree;
+                replay(engines[i], tree, trace);
+            }
+            else
+            {
+                cerr << "unknown engine " << engines[i] << endl;
+                return 1;
+            }
+        }
+    }
+    catch (const exception& e)
+    {
+        cerr << argv[0] << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,269 @@
+#ifndef TRACEDBST_H
+#define TRACEDBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <iterator>
+#include <vector>
+#include <type_traits>
+#include "avlbst.h"
+
+/*
+ * Workload traces
+ *
+ * A trace is a file that starts with the 8 bytes "BSTTRACE" and a version
+ * byte, followed by one record per operation:
+ *
+ *   op (1 byte) | key | arg
+ *
+ * The key is stored as the zigzag-encoded difference from the previous
+ * record's key, as a varint (7 bits per byte, low bits first). Nearby or
+ * repeated keys therefore take one or two bytes. arg is a varint too: the
+ * value for an insert, hi - key for a range, absent for find and remove.
+ * Keys are signed 64-bit integers; trees with other integral keys are
+ * traced through a conversion.
+ */
+
+#define TRACE_MAGIC "BSTTRACE"
+#define TRACE_VERSION 1
+
+enum TraceOp
+{
+    TRACE_INSERT = 1,
+    TRACE_FIND = 2,
+    TRACE_REMOVE = 3,
+    TRACE_RANGE = 4 // visit every item with key <= item <= key + arg
+};
+
+/**
+* One operation of a trace.
+*/
+struct TraceRecord
+{
+    TraceOp op;
+    int64_t key;
+    uint64_t arg; // TRACE_INSERT: the value, TRACE_RANGE: hi - key
+};
+
+/**
+* Appends records to a trace in an output stream. Stream errors are
+* reported by the stream itself.
+*/
+class TraceWriter
+{
+public:
+    TraceWriter(std::ostream& os);
+
+    void record(TraceOp op, int64_t key, uint64_t arg = 0);
+    size_t records() const;
+
+protected:
+    void putVarint(uint64_t number);
+
+protected:
+    std::ostream& os_;
+    int64_t lastKey_;
+    size_t records_;
+};
+
+inline TraceWriter::TraceWriter(std::ostream& os) :
+    os_(os), lastKey_(0), records_(0)
+{
+    os_.write(TRACE_MAGIC, 8);
+    os_.put((char)TRACE_VERSION);
+}
+
+inline void TraceWriter::record(TraceOp op, int64_t key, uint64_t arg)
+{
+    uint64_t delta = (uint64_t)key - (uint64_t)lastKey_;
+    os_.put((char)op);
+    putVarint((delta << 1) ^ (uint64_t)((int64_t)delta >> 63));
+    if (op == TRACE_INSERT || op == TRACE_RANGE) putVarint(arg);
+    lastKey_ = key;
+    records_++;
+}
+
+inline size_t TraceWriter::records() const
+{
+    return records_;
+}
+
+inline void TraceWriter::putVarint(uint64_t number)
+{
+    while (number >= 0x80)
+    {
+        os_.put((char)(number | 0x80));
+        number >>= 7;
+    }
+    os_.put((char)number);
+}
+
+/*
+ * Reads a varint at pos, advancing pos. Returns false if the input ends
+ * early or the number is too long.
+ */
+inline bool traceVarint(const char*& pos, const char* end, uint64_t& number)
+{
+    number = 0;
+    for (int shift = 0; shift < 64 && pos != end; shift += 7)
+    {
+        unsigned char byte = (unsigned char)*pos++;
+        number |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+/**
+* Reads a whole trace from is into records. Throws std::runtime_error if
+* it is not a trace, a record is cut off or an op is unknown; records
+* then holds every record before the bad one.
+*/
+inline void readTrace(std::istream& is, std::vector<TraceRecord>& records)
+{
+    std::string contents((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    if (contents.size() < 9 || contents.compare(0, 8, TRACE_MAGIC) != 0) throw std::runtime_error("not a trace");
+    if (contents[8] != TRACE_VERSION) throw std::runtime_error("unsupported trace version");
+
+    records.clear();
+    const char* pos = contents.data() + 9;
+    const char* end = contents.data() + contents.size();
+    int64_t lastKey = 0;
+    while (pos != end)
+    {
+        TraceRecord record;
+        uint64_t zigzag;
+        unsigned char op = (unsigned char)*pos++;
+        if (op < TRACE_INSERT || op > TRACE_RANGE) throw std::runtime_error("bad trace record");
+        record.op = (TraceOp)op;
+        record.arg = 0;
+        if (!traceVarint(pos, end, zigzag)) throw std::runtime_error("truncated trace");
+        record.key = (int64_t)((uint64_t)lastKey + ((zigzag >> 1) ^ (0 - (zigzag & 1))));
+        if ((record.op == TRACE_INSERT || record.op == TRACE_RANGE) && !traceVarint(pos, end, record.arg))
+        {
+            throw std::runtime_error("truncated trace");
+        }
+        lastKey = record.key;
+        records.push_back(record);
+    }
+}
+
+// The value an insert records: arithmetic values as themselves, anything else as 0.
+template<typename T>
+uint64_t traceValue(const T& item, std::true_type)
+{
+    return (uint64_t)item;
+}
+
+template<typename T>
+uint64_t traceValue(const T& item, std::false_type)
+{
+    return 0;
+}
+
+/**
+* A tree that records find, insert, remove and forEachInRange calls to a
+* trace while a TraceWriter is attached, so a production workload can be
+* captured and replayed later (see trace-replay.cpp). Other calls, such as
+* operator[] and erase, pass through unrecorded. Tree is AVLTree by
+* default and can be any BinarySearchTree with integral keys.
+*/
+template <class Key, class Value, class Tree = AVLTree<Key, Value> >
+class TracedTree : public Tree
+{
+public:
+    typedef typename Tree::iterator iterator;
+
+    TracedTree();
+
+    void startTrace(TraceWriter* writer);
+    void stopTrace();
+
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void remove(const Key& key);
+    using Tree::insert;
+
+    iterator find(const Key& key);
+    iterator find(const Key& key) const;
+    template<typename Function>
+    void forEachInRange(const Key& lo, const Key& hi, Function fn) const;
+
+protected:
+    TraceWriter* writer_;
+};
+
+template<class Key, class Value, class Tree>
+TracedTree<Key, Value, Tree>::TracedTree() :
+    writer_(nullptr)
+{
+    static_assert(std::is_integral<Key>::value, "traces hold integral keys");
+}
+
+/**
+* Records every following operation to writer, until stopTrace.
+*/
+template<class Key, class Value, class Tree>
+void TracedTree<Key, Value, Tree>::startTrace(TraceWriter* writer)
+{
+    writer_ = writer;
+}
+
+template<class Key, class Value, class Tree>
+void TracedTree<Key, Value, Tree>::stopTrace()
+{
+    writer_ = nullptr;
+}
+
+template<class Key, class Value, class Tree>
+void TracedTree<Key, Value, Tree>::insert(const std::pair<const Key, Value>& new_item)
+{
+    if (writer_ != nullptr)
+    {
+        writer_->record(TRACE_INSERT, (int64_t)new_item.first,
+                        traceValue(new_item.second, std::integral_constant<bool, std::is_arithmetic<Value>::value>()));
+    }
+    Tree::insert(new_item);
+}
+
+template<class Key, class Value, class Tree>
+void TracedTree<Key, Value, Tree>::remove(const Key& key)
+{
+    if (writer_ != nullptr) writer_->record(TRACE_REMOVE, (int64_t)key);
+    Tree::remove(key);
+}
+
+/*
+ * Calls the tree's own non-const find, so self-adjusting trees still
+ * adjust while traced.
+ */
+template<class Key, class Value, class Tree>
+typename TracedTree<Key, Value, Tree>::iterator TracedTree<Key, Value, Tree>::find(const Key& key)
+{
+    if (writer_ != nullptr) writer_->record(TRACE_FIND, (int64_t)key);
+    return Tree::find(key);
+}
+
+template<class Key, class Value, class Tree>
+typename TracedTree<Key, Value, Tree>::iterator TracedTree<Key, Value, Tree>::find(const Key& key) const
+{
+    if (writer_ != nullptr) writer_->record(TRACE_FIND, (int64_t)key);
+    return Tree::find(key);
+}
+
+/**
+* Calls fn with every item whose key is in [lo, hi], in order.
+*/
+template<class Key, class Value, class Tree>
+template<typename Function>
+void TracedTree<Key, Value, Tree>::forEachInRange(const Key& lo, const Key& hi, Function fn) const
+{
+    if (hi < lo) return;
+    if (writer_ != nullptr) writer_->record(TRACE_RANGE, (int64_t)lo, (uint64_t)(int64_t)hi - (uint64_t)(int64_t)lo);
+    for (iterator it = this->lowerBound(lo); it != this->end() && !(hi < it->first); ++it) fn(*it);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Times a full structural validation of a large AVLTree on one thread
+// and on every hardware thread.
+//   usage: ./validate-bench [numKeys]
+
+double timeValidate(const AVLTree<int, int>& tree, unsigned threads, ValidationReport& report)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    report = tree.validate(threads);
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(stop - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    int numKeys = argc > 1 ? atoi(argv[1]) : 4000000;
+
+    AVLTree<int, int> tree;
+    for (int i = 0; i < numKeys; i++) tree.insert(make_pair(i, i));
+
+    ValidationReport report;
+    unsigned hardwareThreads = thread::hardware_concurrency();
+    cout << "nodes=" << numKeys << endl;
+    cout << "1 thread : " << timeValidate(tree, 1, report) << " ms" << endl;
+    cout << hardwareThreads << " threads: " << timeValidate(tree, 0, report) << " ms" << endl;
+    cout << "ok=" << report.ok() << " height=" << report.height
+         << " leaf depths " << report.minLeafDepth << ".." << report.maxLeafDepth << endl;
+    return 0;
+}
@@ -0,0 +1,224 @@
+#ifndef VALIDATE_BST_H
+#define VALIDATE_BST_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+// BST structural validation
+//
+// Checks key ordering, parent pointers, height balance, stored balance
+// factors (for trees that keep them) and leaf depths in a single post-order
+// pass. The top of the tree is split across threads; below that every
+// subtree is walked iteratively, so degenerate trees cannot overflow the
+// stack.
+
+/**
+* Result of BinarySearchTree::validate(). Leaf depths count the root as 1.
+*/
+struct ValidationReport
+{
+    size_t nodeCount;
+    int height;
+    int minLeafDepth;
+    int maxLeafDepth;
+    bool ordered;               // in-order keys strictly increase
+    bool parentsConsistent;     // every child points back at its parent, the root at NULL
+    bool heightBalanced;        // subtree heights differ by at most one everywhere
+    bool balanceFactorsCorrect; // stored balance factors match real heights
+    bool equalLeafDepths;       // every leaf is at the same depth
+    bool balanceRequired;       // the tree keeps itself height balanced (AVL trees)
+
+    // true if the tree is a valid search tree with correct bookkeeping,
+    // and height balanced if it promises to be
+    bool ok() const
+    {
+        return ordered && parentsConsistent && balanceFactorsCorrect && (heightBalanced || !balanceRequired);
+    }
+};
+
+// Summary of one subtree, combined bottom-up.
+template<typename Key, typename Value>
+struct ValidationSummary
+{
+    const Node<Key, Value>* minNode;
+    const Node<Key, Value>* maxNode;
+    size_t count;
+    int height;
+    int minLeaf; // leaf depths relative to the subtree root (root = 1)
+    int maxLeaf;
+    bool ordered;
+    bool parents;
+    bool heightBalanced;
+    bool balanceFactors;
+};
+
+// don't hand subtrees to new threads below this depth
+#define VALIDATE_MAX_SPLIT_DEPTH 16
+
+/**
+* Combines the summaries of the children of thisNode into its own summary.
+* left/right are NULL for missing children.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::combineValidation(const Node<Key, Value>* thisNode,
+    const ValidationSummary<Key, Value>* left, const ValidationSummary<Key, Value>* right,
+    ValidationSummary<Key, Value>& result) const
+{
+    int leftHeight = left ? left->height : 0;
+    int rightHeight = right ? right->height : 0;
+
+    result.minNode = left ? left->minNode : thisNode;
+    result.maxNode = right ? right->maxNode : thisNode;
+    result.count = 1 + (left ? left->count : 0) + (right ? right->count : 0);
+    result.height = 1 + std::max(leftHeight, rightHeight);
+
+    if (left == nullptr && right == nullptr)
+    {
+        result.minLeaf = 1;
+        result.maxLeaf = 1;
+    }
+    else
+    {
+        result.minLeaf = 1 + std::min(left ? left->minLeaf : right->minLeaf, right ? right->minLeaf : left->minLeaf);
+        result.maxLeaf = 1 + std::max(left ? left->maxLeaf : 0, right ? right->maxLeaf : 0);
+    }
+
+    result.ordered = (left == nullptr || (left->ordered && left->maxNode->getKey() < thisNode->getKey()))
+                  && (right == nullptr || (right->ordered && thisNode->getKey() < right->minNode->getKey()));
+    result.parents = (left == nullptr || (left->parents && thisNode->getLeft()->getParent() == thisNode))
+                  && (right == nullptr || (right->parents && thisNode->getRight()->getParent() == thisNode));
+    result.heightBalanced = (left == nullptr || left->heightBalanced)
+                         && (right == nullptr || right->heightBalanced)
+                         && leftHeight - rightHeight <= 1 && rightHeight - leftHeight <= 1;
+    result.balanceFactors = (left == nullptr || left->balanceFactors)
+                         && (right == nullptr || right->balanceFactors)
+                         && checkNodeBalance(thisNode, leftHeight, rightHeight);
+}
+
+/**
+* Summarizes the subtree at root with an iterative post-order walk.
+* @precondition root is not NULL
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::validateSubtree(const Node<Key, Value>* root,
+    ValidationSummary<Key, Value>& result) const
+{
+    // frames hold a node and whether its children have been summarized;
+    // summaries of finished subtrees are kept on their own stack
+    std::vector<std::pair<const Node<Key, Value>*, bool> > frames;
+    std::vector<ValidationSummary<Key, Value> > done;
+    frames.push_back(std::make_pair(root, false));
+
+    while (!frames.empty())
+    {
+        const Node<Key, Value>* currentNode = frames.back().first;
+        if (!frames.back().second)
+        {
+            frames.back().second = true;
+            if (currentNode->getRight() != nullptr) frames.push_back(std::make_pair(currentNode->getRight(), false));
+            if (currentNode->getLeft() != nullptr) frames.push_back(std::make_pair(currentNode->getLeft(), false));
+            continue;
+        }
+        frames.pop_back();
+
+        // children were pushed right then left, so their summaries are on top as left, right
+        ValidationSummary<Key, Value> summary;
+        const ValidationSummary<Key, Value>* right = nullptr;
+        const ValidationSummary<Key, Value>* left = nullptr;
+        size_t numChildren = (currentNode->getLeft() != nullptr) + (currentNode->getRight() != nullptr);
+        size_t base = done.size() - numChildren;
+        if (currentNode->getLeft() != nullptr) left = &done[base];
+        if (currentNode->getRight() != nullptr) right = &done[base + (left != nullptr)];
+        combineValidation(currentNode, left, right, summary);
+        done.resize(base);
+        done.push_back(summary);
+    }
+    result = done.back();
+}
+
+/**
+* Summarizes the subtree at root, handing the right subtree to another
+* thread while threads remain. threads is the number of threads this call
+* may use (including the calling one).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::validateParallel(const Node<Key, Value>* root, unsigned threads,
+    int depth, ValidationSummary<Key, Value>& result) const
+{
+    if (threads <= 1 || depth >= VALIDATE_MAX_SPLIT_DEPTH
+        || root->getLeft() == nullptr || root->getRight() == nullptr)
+    {
+        validateSubtree(root, result);
+        return;
+    }
+
+    ValidationSummary<Key, Value> left, right;
+    unsigned rightThreads = threads / 2;
+    std::thread worker(&BinarySearchTree<Key, Value>::validateParallel, this,
+                       root->getRight(), rightThreads, depth + 1, std::ref(right));
+    validateParallel(root->getLeft(), threads - rightThreads, depth + 1, left);
+    worker.join();
+
+    combineValidation(root, &left, &right, result);
+}
+
+/**
+* Checks the whole tree in one traversal and reports what it found.
+* threads = 0 uses every hardware thread.
+*/
+template<typename Key, typename Value>
+ValidationReport BinarySearchTree<Key, Value>::validate(unsigned threads) const
+{
+    ValidationReport report;
+    report.balanceRequired = keepsBalance();
+    if (root_ == nullptr)
+    {
+        report.nodeCount = 0;
+        report.height = 0;
+        report.minLeafDepth = 0;
+        report.maxLeafDepth = 0;
+        report.ordered = report.parentsConsistent = report.heightBalanced = true;
+        report.balanceFactorsCorrect = report.equalLeafDepths = true;
+        return report;
+    }
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    ValidationSummary<Key, Value> summary;
+    validateParallel(root_, threads, 0, summary);
+
+    report.nodeCount = summary.count;
+    report.height = summary.height;
+    report.minLeafDepth = summary.minLeaf;
+    report.maxLeafDepth = summary.maxLeaf;
+    report.ordered = summary.ordered;
+    report.parentsConsistent = summary.parents && root_->getParent() == nullptr;
+    report.heightBalanced = summary.heightBalanced;
+    report.balanceFactorsCorrect = summary.balanceFactors;
+    report.equalLeafDepths = summary.minLeaf == summary.maxLeaf;
+    return report;
+}
+
+/**
+* Checks any balance information stored in a node against the real
+* heights of its subtrees. A plain BST stores none.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::checkNodeBalance(const Node<Key, Value>* thisNode, int leftHeight, int rightHeight) const
+{
+    return true;
+}
+
+/*
+ * Whether every node's subtrees must differ in height by at most one.
+ * Self-balancing trees that promise it override this.
+ */
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::keepsBalance() const
+{
+    return false;
+}
+
+#endif
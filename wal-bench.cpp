@@ -0,0 +1,56 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include <unistd.h>
+#include "durablebst.h"
+
+using namespace std;
+
+// Durable insert throughput against a local file for several group commit
+// sizes, with and without fsync, plus the time to recover the result.
+//   usage: ./wal-bench [numItems] [path]
+
+static void removeFiles(const string& path)
+{
+    unlink((path + ".wal").c_str());
+    unlink((path + ".snap").c_str());
+}
+
+static void run(const string& path, size_t numItems, size_t group, bool sync)
+{
+    removeFiles(path);
+    DurabilityOptions options;
+    options.groupCommitOps = group;
+    options.sync = sync;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    {
+        DurableAVLTree<uint64_t, uint64_t> tree(path, options);
+        for (size_t i = 0; i < numItems; i++) tree.insert(make_pair((uint64_t)(i * 2654435761u % numItems), (uint64_t)i));
+        tree.commit();
+    }
+    chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+    DurableAVLTree<uint64_t, uint64_t> recovered(path, options);
+    chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+    double seconds = chrono::duration<double>(middle - start).count();
+    cout << "group=" << group << (sync ? " fsync   " : " no-sync ")
+         << ": " << (size_t)(numItems / seconds) << " inserts/s, recovery "
+         << chrono::duration<double, milli>(stop - middle).count() << " ms ("
+         << recovered.size() << " items)" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t numItems = argc > 1 ? atol(argv[1]) : 20000;
+    string path = argc > 2 ? argv[2] : "wal-bench.db";
+
+    cout << "items=" << numItems << " path=" << path << endl;
+    run(path, numItems, 1, true);
+    run(path, numItems, 16, true);
+    run(path, numItems, 256, true);
+    run(path, numItems, 256, false);
+    removeFiles(path);
+    return 0;
+}